@@ -16,6 +16,10 @@ option(WITHOUT_GIT                    "Disable the GIT testing routines"
 option(WITH_DYNAMIC_LINKING           "Enable dynamic library linking."                             0)
 option(CONFIG_ABORT_INCORRECT_OPTIONS "Enable abort if core found incorrect option in config files" 0)
 
+# Highest log level compiled in, LOG_* calls above it are removed with their arguments
+set(LOG_COMPILE_LEVEL "8" CACHE STRING "Highest compiled log level: 0 - none, 1 - fatal ... 7 - debug, 8 - trace")
+set_property(CACHE LOG_COMPILE_LEVEL PROPERTY STRINGS 0 1 2 3 4 5 6 7 8)
+
 if (WITH_DYNAMIC_LINKING)
   set(BUILD_SHARED_LIBS ON)
 else()
@@ -30,6 +30,14 @@ else()
   message("* Show compile-warnings    : No  (default)")
 endif()
 
+if (LOG_COMPILE_LEVEL LESS 8)
+  message("* Compiled log level       : ${LOG_COMPILE_LEVEL} (LOG_* above it are removed)")
+else()
+  message("* Compiled log level       : All (default)")
+endif()
+
+add_definitions(-DWARHEAD_LOG_COMPILE_LEVEL=${LOG_COMPILE_LEVEL})
+
 if (WIN32)
   if(NOT WITH_SOURCE_TREE STREQUAL "no")
     message("* Show source tree         : Yes - \"${WITH_SOURCE_TREE}\"")
@@ -22,6 +22,7 @@
 #include "Log.h"
 #include "Logo.h"
 #include "DiscordConfig.h"
+#include "DiscordLogChannel.h"
 #include "ClientSocketMgr.h"
 #include <boost/version.hpp>
 
@@ -54,12 +55,13 @@ int main(int argc, char** argv)
         return 1;
 
     // Init logging
+    DiscordLogChannel::Register();
     sLog->Initialize();
 
     Warhead::Logo::Show("discordclient",
         [](std::string_view text)
         {
-            LOG_INFO("server", text);
+            LOG_INFO("server", "{}", text);
         },
         []()
         {
@@ -82,6 +84,9 @@ int main(int argc, char** argv)
     // Start the io service worker loop
     ioContext->run();
 
+    // Log outlives the client, its discord channels must not send from now on
+    DiscordLogChannel::Shutdown();
+
     LOG_INFO("server.authserver", "Halting process...");
 
     return 0;
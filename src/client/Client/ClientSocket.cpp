@@ -24,7 +24,6 @@
 #include "Log.h"
 #include "DiscordConfig.h"
 #include "Timer.h"
-#include "GitRevision.h"
 #include "SmartEnum.h"
 
 namespace
@@ -39,47 +38,16 @@ namespace
     }
 }
 
-constexpr auto WARHEAD_DISCORD_VERSION = 100000;
-//constexpr auto WARHEAD_DISCORD_VERSION_MAJOR = WARHEAD_DISCORD_VERSION / 100000;
-//constexpr auto WARHEAD_DISCORD_VERSION_MINOR = WARHEAD_DISCORD_VERSION / 100 % 1000;
-//constexpr auto WARHEAD_DISCORD_VERSION_PATCH = WARHEAD_DISCORD_VERSION % 100;
-
 ClientSocket::ClientSocket(tcp::socket&& socket) :
     Socket(std::move(socket))
 {
-    _accountName = CONF_GET_STR("Discord.Server.Account.Name");
-    _accountKey = CONF_GET_STR("Discord.Server.Account.Key");
-    _serverID = sDiscordConfig->GetOption<int64>("Discord.Server.ID");
-
-    if (!_serverID)
-    {
-        LOG_ERROR("discord", "> Empty server id");
-        sClientSocketMgr->Disconnect();
-        CloseSocket();
-    }
-
-    if (_accountName.empty())
-    {
-        LOG_ERROR("discord", "> Empty account name");
-        sClientSocketMgr->Disconnect();
-        CloseSocket();
-    }
-
-    if (_accountKey.empty())
-    {
-        LOG_ERROR("discord", "> Empty key");
-        sClientSocketMgr->Disconnect();
-        CloseSocket();
-    }
-
     _headerBuffer.Resize(sizeof(DiscordClientPktHeader));
     SetNoDelay(true);
 }
 
 void ClientSocket::Start()
 {
-    LOG_DEBUG("node", "Start process auth from server. Account name '{}'", _accountName);
-    SendAuthSession();
+    AsyncRead();
 }
 
 void ClientSocket::OnClose()
@@ -89,15 +57,13 @@ void ClientSocket::OnClose()
 
 bool ClientSocket::Update()
 {
-    if (_authed)
+    // After a resume the replayed packets were sent first, before Start
+    while (!_bufferQueue.Empty())
     {
-        DiscordPacket* queuedPacket{ nullptr };
-
-        while (_bufferQueue.GetNextPacket(queuedPacket))
-        {
-            SendPacket(queuedPacket);
-            delete queuedPacket;
-        }
+        DiscordPacket& packet = _bufferQueue.Front();
+        SendPacket(&packet);
+        sClientSocketMgr->AddSentPacket(std::move(packet));
+        _bufferQueue.PopFront();
     }
 
     if (!BaseSocket::Update())
@@ -197,36 +163,20 @@ ClientSocket::ReadDataHandlerResult ClientSocket::ReadDataHandler()
 
     switch (opcode)
     {
+        // Handshake responses are read by the connection operation before this socket exists
         case SERVER_SEND_AUTH_RESPONSE:
+        case SERVER_SEND_RESUME_RESPONSE:
         {
-            if (_authed)
-            {
-                // locking just to safely log offending user is probably overkill but we are disconnecting him anyway
-                if (sessionGuard.try_lock())
-                    LOG_ERROR("node", "{}: received duplicate SERVER_SEND_AUTH_RESPONSE", __FUNCTION__);
-
-                sClientSocketMgr->Disconnect();
-                return ReadDataHandlerResult::Error;
-            }
+            // locking just to safely log offending user is probably overkill but we are disconnecting him anyway
+            if (sessionGuard.try_lock())
+                LOG_ERROR("node", "{}: received handshake response {} after the handshake", __FUNCTION__, opcode);
 
-            HandleAuthResponce(packet);
-            return ReadDataHandlerResult::Ok;
+            sClientSocketMgr->Disconnect();
+            return ReadDataHandlerResult::Error;
         }
         case SERVER_SEND_PONG:
-        {
-            if (!_authed)
-            {
-                // locking just to safely log offending user is probably overkill but we are disconnecting him anyway
-                if (sessionGuard.try_lock())
-                    LOG_ERROR("node", "{}: received SERVER_SEND_PONG without auth", __FUNCTION__);
-
-                sClientSocketMgr->Disconnect();
-                return ReadDataHandlerResult::Error;
-            }
-
             HandlePong(packet);
             return ReadDataHandlerResult::Ok;
-        }
         default:
             return ReadDataHandlerResult::Error;
     }
@@ -237,6 +187,19 @@ void ClientSocket::LogOpcode(DiscordCode opcode)
     LOG_TRACE("network.opcode", "C->S: {}", GetOpcodeNameForLoggingImpl(opcode));
 }
 
+/*static*/ MessageBuffer ClientSocket::EncodePacket(DiscordPacket const& packet)
+{
+    DiscordServerPktHeader header(packet.size() + sizeof(packet.GetOpcode()), packet.GetOpcode());
+
+    MessageBuffer buffer(packet.size() + header.GetHeaderLength());
+    buffer.Write(header.header, header.GetHeaderLength());
+
+    if (!packet.empty())
+        buffer.Write(packet.contents(), packet.size());
+
+    return buffer;
+}
+
 void ClientSocket::SendPacket(DiscordPacket const* packet)
 {
     if (!IsOpen())
@@ -245,63 +208,23 @@ void ClientSocket::SendPacket(DiscordPacket const* packet)
         return;
     }
 
-    MessageBuffer buffer;
-
-    DiscordServerPktHeader header(packet->size() + sizeof(packet->GetOpcode()), packet->GetOpcode());
-    if (buffer.GetRemainingSpace() < packet->size() + header.GetHeaderLength())
-    {
-        QueuePacket(std::move(buffer));
-        //buffer.Resize(4096);
-    }
-
-    if (buffer.GetRemainingSpace() >= packet->size() + header.GetHeaderLength())
-    {
-        buffer.Write(header.header, header.GetHeaderLength());
-        if (!packet->empty())
-            buffer.Write(packet->contents(), packet->size());
-    }
-    else // single packet larger than 4096 bytes
-    {
-        MessageBuffer packetBuffer(packet->size() + header.GetHeaderLength());
-        packetBuffer.Write(header.header, header.GetHeaderLength());
-        if (!packet->empty())
-            packetBuffer.Write(packet->contents(), packet->size());
-
-        QueuePacket(std::move(packetBuffer));
-    }
-
-    if (buffer.GetActiveSize() > 0)
-        QueuePacket(std::move(buffer));
+    QueuePacket(EncodePacket(*packet));
 }
 
 void ClientSocket::AddPacketToQueue(DiscordPacket const& packet)
 {
-    _bufferQueue.AddPacket(new DiscordPacket(packet));
+    _bufferQueue.PushBack(packet);
 }
 
-void ClientSocket::HandleAuthResponce(DiscordPacket& packet)
+void ClientSocket::AddPacketToQueue(DiscordPacket&& packet)
 {
-    using namespace std::chrono;
-
-    Microseconds diff = duration_cast<Microseconds>(steady_clock::now() - _startTime);
-
-    uint8 code;
-    packet >> code;
-
-    DiscordAuthResponseCodes responseCode = static_cast<DiscordAuthResponseCodes>(code);
-    auto const& codeString = EnumUtils::ToTitle(responseCode);
-
-    if (responseCode != DiscordAuthResponseCodes::Ok)
-    {
-        LOG_INFO("server", "Auth incorrect. Code {}", codeString);
-        sClientSocketMgr->Disconnect();
-        return;
-    }
-
-    LOG_INFO("server", "[{}] Auth correct '{}'", Warhead::Time::ToTimeString(diff), codeString);
-    _authed = true;
+    _bufferQueue.PushBack(std::move(packet));
+}
 
-    SendPingMessage();
+void ClientSocket::TakeQueuedPackets(std::deque<DiscordPacket>& packets)
+{
+    _bufferQueue.ForEach([&packets](DiscordPacket& packet) { packets.emplace_back(std::move(packet)); });
+    _bufferQueue.Clear();
 }
 
 void ClientSocket::SendPingMessage()
@@ -327,20 +250,11 @@ void ClientSocket::HandlePong(DiscordPacket& packet)
     _latency = duration_cast<Microseconds>(timeNow - Microseconds(timePacket));
 
     LOG_INFO("server", "> Latency {}", Warhead::Time::ToTimeString(_latency));
-}
-
-void ClientSocket::SendAuthSession()
-{
-    DiscordPacket packet(CLIENT_AUTH_SESSION, 1);
-    packet << _accountName;
-    packet << _accountKey;
-    packet << GitRevision::GetCompanyNameStr();
-    packet << GitRevision::GetFileVersionStr();
-    packet << uint32(WARHEAD_DISCORD_VERSION);
-    packet << int64(_serverID);
-    SendPacket(&packet);
-
-    _startTime = std::chrono::steady_clock::now();
 
-    AsyncRead();
+    if (packet.rpos() < packet.size())
+    {
+        uint64 receivedSequence;
+        packet >> receivedSequence;
+        sClientSocketMgr->AcknowledgePackets(receivedSequence);
+    }
 }
@@ -22,9 +22,11 @@
 #include "PacketQueue.h"
 #include "DiscordPacket.h"
 #include "DiscordSharedDefines.h"
+#include <deque>
 #include <mutex>
 
-/// Manages all sockets connected to peers and network threads
+/// Connection to the discord server after the handshake, which is done by ClientSocketMgr.
+/// Sends the queued packets and handles the pongs
 class WH_CLIENT_API ClientSocket : public Socket<ClientSocket>
 {
     using BaseSocket = Socket<ClientSocket>;
@@ -35,11 +37,15 @@ public:
     void Start() override;
     bool Update() override;
 
-    inline bool IsAuthed() { return _authed; }
-    inline void SetAccountName(std::string_view name) { _accountName = std::string(_accountName); }
     inline Microseconds GetLatency() { return _latency; }
-    
+
+    /// Header and payload as sent on the wire
+    static MessageBuffer EncodePacket(DiscordPacket const& packet);
+
     void AddPacketToQueue(DiscordPacket const& packet);
+    void AddPacketToQueue(DiscordPacket&& packet);
+    void TakeQueuedPackets(std::deque<DiscordPacket>& packets);
+    void SendPacket(DiscordPacket const* packet);
     void SendPingMessage();
 
 protected:
@@ -57,26 +63,18 @@ private:
     ReadDataHandlerResult ReadDataHandler();
     bool ReadHeaderHandler();
 
-    void SendAuthSession();
-
-    void HandleAuthResponce(DiscordPacket& packet);
     void HandlePong(DiscordPacket& packet);
     void LogOpcode(DiscordCode opcode);
 
-    void SendPacket(DiscordPacket const* packet);
-
     std::mutex _sessionLock;
     MessageBuffer _headerBuffer;
     MessageBuffer _packetBuffer;
-    bool _authed{ false };
-    std::string _accountName;
-    std::string _accountKey;
-    int64 _serverID;
 
-    TimePoint _startTime;
     Microseconds _latency{ 0us };
 
-    PacketQueue<DiscordPacket> _bufferQueue;
+    // Filled and drained by the io thread, so no lock and no bound: packets are stored by value,
+    // memory is allocated only when the ring grows, nothing is dropped during a burst or after a long outage
+    Warhead::Impl::RingBuffer<DiscordPacket> _bufferQueue;
 };
 
 #endif
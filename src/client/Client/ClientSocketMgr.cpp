@@ -17,10 +17,336 @@
 
 #include "ClientSocketMgr.h"
 #include "ClientSocket.h"
+#include "AsyncOperations.h"
 #include "IoContext.h"
 #include "DeadlineTimer.h"
 #include "DiscordConfig.h"
+#include "DiscordPacketHeader.h"
+#include "GitRevision.h"
+#include "Log.h"
 #include "Resolver.h"
+#include "Scheduler.h"
+#include "SmartEnum.h"
+#include "Timer.h"
+#include <boost/asio/coroutine.hpp>
+#include <boost/asio/write.hpp>
+
+namespace
+{
+    constexpr Seconds CLIENT_RECONNECT_DELAY = 5s;
+    constexpr uint32 CLIENT_RECONNECT_COUNT = 3; // after a connection loss
+    constexpr auto WARHEAD_DISCORD_VERSION = 100000;
+
+    //constexpr auto WARHEAD_DISCORD_VERSION_MAJOR = WARHEAD_DISCORD_VERSION / 100000;
+    //constexpr auto WARHEAD_DISCORD_VERSION_MINOR = WARHEAD_DISCORD_VERSION / 100 % 1000;
+    //constexpr auto WARHEAD_DISCORD_VERSION_PATCH = WARHEAD_DISCORD_VERSION % 100;
+
+    // Payload size of a server frame, the opcode is not included. Empty for a malformed header
+    std::optional<std::size_t> GetServerFrameSize(uint8* headerData)
+    {
+        DiscordClientPktHeader* header = reinterpret_cast<DiscordClientPktHeader*>(headerData);
+        EndianConvertReverse(header->size);
+        EndianConvert(header->cmd);
+
+        if (!header->IsValidSize() || !header->IsValidOpcode())
+            return {};
+
+        return header->size - sizeof(header->cmd);
+    }
+}
+
+// The whole connection as one stackless coroutine: connect with retries, auth or resume, ping while the socket
+// is open, reconnect after it is closed. Every step is an async call on the io thread resumed by its completion,
+// so there are no blocking connect, read or sleep calls. Copies of the operation share one state
+class ClientSocketMgr::ConnectionOperation : public boost::asio::coroutine
+{
+    enum class HandshakeResult
+    {
+        Done,
+        RetryAuth,  // resume refused, auth on the same connection
+        Reconnect,
+        Refused     // auth refused, stop
+    };
+
+    struct State
+    {
+        tcp::endpoint Endpoint;
+        uint32 ReconnectCount{ 1 };
+        uint32 Attempt{ 0 };
+        bool Delay{ false }; // wait before the first connect attempt, after a failed handshake
+        std::shared_ptr<tcp::socket> Socket;
+
+        // Handshake
+        bool Resuming{ false };
+        bool Resumed{ false };
+        TimePoint StartTime;
+        MessageBuffer Request;
+        MessageBuffer Header{ sizeof(DiscordClientPktHeader) };
+        MessageBuffer Payload;
+        HandshakeResult Result{ HandshakeResult::Done };
+    };
+
+public:
+    ConnectionOperation(ClientSocketMgr* mgr, uint32 reconnectCount) :
+        _mgr(mgr), _state(std::make_shared<State>())
+    {
+        _state->ReconnectCount = reconnectCount;
+    }
+
+#include <boost/asio/yield.hpp>
+    void operator()(boost::system::error_code const& error = {}, std::size_t /*transferred*/ = 0)
+    {
+        // Connection logs are not forwarded to the discord log channel
+        LogForwardGuard forwardGuard;
+
+        reenter (this)
+        {
+            if (_mgr->_connectionRunning)
+            {
+                LOG_DEBUG("discord.client", "> Connection is already running");
+                return;
+            }
+
+            if (!_mgr->_address)
+            {
+                LOG_ERROR("discord.client", "> Could not resolve address. Skip connect");
+                return;
+            }
+
+            _mgr->_connectionRunning = true;
+            _state->Endpoint = tcp::endpoint(*_mgr->_address, sDiscordConfig->GetOption<uint16>("Discord.Server.Port"));
+
+            for (;;)
+            {
+                LOG_INFO("discord.client", "> Start connect to discord server...");
+
+                _state->Socket = std::make_shared<tcp::socket>(Warhead::Asio::get_io_context(*_mgr->_updateTimer));
+                _mgr->_pendingSocket = _state->Socket;
+
+                for (_state->Attempt = 0; _state->Attempt < _state->ReconnectCount; ++_state->Attempt)
+                {
+                    if (_state->Attempt || _state->Delay)
+                    {
+                        LOG_WARN("discord.client", "> Wait {} seconds before next connect", CLIENT_RECONNECT_DELAY.count());
+                        yield _mgr->_scheduler->After(CLIENT_RECONNECT_DELAY, *this);
+
+                        if (_mgr->_stopped)
+                            return Finish();
+                    }
+
+                    yield _state->Socket->async_connect(_state->Endpoint, *this);
+
+                    if (_mgr->_stopped)
+                        return Finish();
+
+                    if (!error)
+                        break;
+
+                    LOG_WARN("discord.client", "Failed connect. Error {}", error.message());
+
+                    // Reset the failed socket, the next async_connect opens it again
+                    CloseSocket();
+                }
+
+                if (_state->Attempt == _state->ReconnectCount)
+                {
+                    Finish();
+                    _mgr->Disconnect();
+                    return;
+                }
+
+                // Auth or resume before any other packet is sent
+                _state->Resuming = _mgr->CanResumeSession();
+                if (!_state->Resuming)
+                    _mgr->ResetSession();
+
+                do
+                {
+                    _state->Request = ClientSocket::EncodePacket(_state->Resuming ? BuildResumeSession() : BuildAuthSession());
+                    _state->StartTime = std::chrono::steady_clock::now();
+
+                    yield boost::asio::async_write(*_state->Socket,
+                        boost::asio::buffer(_state->Request.GetReadPointer(), _state->Request.GetActiveSize()), *this);
+
+                    if (!error)
+                    {
+                        yield Warhead::Asio::AsyncReadFrame(*_state->Socket, _state->Header, _state->Payload, &GetServerFrameSize, *this);
+                    }
+
+                    if (_mgr->_stopped)
+                        return Finish();
+
+                    _state->Result = HandleHandshakeResponse(error);
+                } while (_state->Result == HandshakeResult::RetryAuth);
+
+                if (_state->Result == HandshakeResult::Refused)
+                {
+                    Finish();
+                    _mgr->Disconnect();
+                    return;
+                }
+
+                _state->Delay = _state->Result == HandshakeResult::Reconnect;
+
+                if (_state->Result == HandshakeResult::Done)
+                {
+                    OnConnected();
+
+                    // Pong acknowledges received packets, so the resume history is trimmed every interval.
+                    // Update cancels the wait when the socket is closed
+                    while (_mgr->_clientSocket)
+                    {
+                        _mgr->_clientSocket->SendPingMessage();
+                        yield _mgr->_scheduler->After(_mgr->_pingInterval, *this);
+
+                        if (_mgr->_stopped)
+                            return Finish();
+                    }
+
+                    LOG_WARN("server", "> Socket is closed. Start reconnect");
+                }
+                else
+                    CloseSocket();
+
+                _state->ReconnectCount = CLIENT_RECONNECT_COUNT;
+            }
+        }
+    }
+#include <boost/asio/unyield.hpp>
+
+private:
+    DiscordPacket BuildAuthSession() const
+    {
+        LOG_DEBUG("node", "Start process auth from server. Account name '{}'", _mgr->GetAccountName());
+
+        DiscordPacket packet(CLIENT_AUTH_SESSION, 1);
+        packet << _mgr->GetAccountName();
+        packet << _mgr->GetAccountKey();
+        packet << GitRevision::GetCompanyNameStr();
+        packet << GitRevision::GetFileVersionStr();
+        packet << uint32(WARHEAD_DISCORD_VERSION);
+        packet << int64(_mgr->GetServerID());
+        return packet;
+    }
+
+    DiscordPacket BuildResumeSession() const
+    {
+        LOG_DEBUG("node", "Start process resume session. Account name '{}'", _mgr->GetAccountName());
+
+        DiscordPacket packet(CLIENT_RESUME_SESSION, 1);
+        packet << _mgr->GetResumeToken();
+        packet << uint64(_mgr->GetAckedSequence());
+        return packet;
+    }
+
+    HandshakeResult HandleHandshakeResponse(boost::system::error_code const& error)
+    {
+        using namespace std::chrono;
+
+        if (error)
+        {
+            LOG_WARN("discord.client", "Failed {}. Error {}", _state->Resuming ? "resume" : "auth", error.message());
+            return HandshakeResult::Reconnect;
+        }
+
+        DiscordClientPktHeader const* header = reinterpret_cast<DiscordClientPktHeader const*>(_state->Header.GetReadPointer());
+        DiscordCode opcode = static_cast<DiscordCode>(header->cmd);
+        DiscordCode expected = _state->Resuming ? SERVER_SEND_RESUME_RESPONSE : SERVER_SEND_AUTH_RESPONSE;
+
+        if (opcode != expected)
+        {
+            LOG_ERROR("node", "{}: received {} instead of {}", __FUNCTION__, opcode, expected);
+            return HandshakeResult::Reconnect;
+        }
+
+        DiscordPacket packet(opcode, std::move(_state->Payload));
+        Microseconds diff = duration_cast<Microseconds>(steady_clock::now() - _state->StartTime);
+
+        uint8 code;
+        packet >> code;
+
+        DiscordAuthResponseCodes responseCode = static_cast<DiscordAuthResponseCodes>(code);
+        auto const& codeString = EnumUtils::ToTitle(responseCode);
+
+        if (_state->Resuming)
+        {
+            _state->Resuming = false;
+
+            if (responseCode != DiscordAuthResponseCodes::Ok)
+            {
+                // Queued packets wait for the new session, unacknowledged ones of the old session are dropped
+                LOG_INFO("server", "Resume session failed. Code {}. Start auth", codeString);
+                _mgr->ResetSession();
+                return HandshakeResult::RetryAuth;
+            }
+
+            uint64 receivedSequence;
+            packet >> receivedSequence;
+
+            LOG_INFO("server", "[{}] Session resumed", Warhead::Time::ToTimeString(diff));
+
+            // Continue right after the last packet received by the server
+            _mgr->AcknowledgePackets(receivedSequence);
+            _state->Resumed = true;
+            return HandshakeResult::Done;
+        }
+
+        if (responseCode != DiscordAuthResponseCodes::Ok)
+        {
+            LOG_INFO("server", "Auth incorrect. Code {}", codeString);
+            return HandshakeResult::Refused;
+        }
+
+        LOG_INFO("server", "[{}] Auth correct '{}'", Warhead::Time::ToTimeString(diff), codeString);
+
+        // Optional resume token, older servers don't send it
+        if (packet.rpos() < packet.size())
+        {
+            std::string token;
+            uint32 window;
+            packet >> token;
+            packet >> window;
+
+            _mgr->SetResumeToken(token, Seconds(window));
+        }
+
+        _state->Resumed = false;
+        return HandshakeResult::Done;
+    }
+
+    void OnConnected()
+    {
+        _mgr->_pendingSocket.reset();
+        _mgr->_clientSocket = std::make_shared<ClientSocket>(std::move(*_state->Socket));
+
+        // Replay of an accepted resume first, then the packets left by the closed socket, flushed by Update
+        if (_state->Resumed)
+            for (auto const& unackedPacket : _mgr->GetUnackedPackets())
+                _mgr->_clientSocket->SendPacket(&unackedPacket);
+
+        for (auto& packet : _mgr->_unsentPackets)
+            _mgr->_clientSocket->AddPacketToQueue(std::move(packet));
+
+        _mgr->_unsentPackets.clear();
+        _mgr->_clientSocket->Start();
+        _mgr->ScheduleUpdate();
+    }
+
+    void CloseSocket()
+    {
+        boost::system::error_code ignored;
+        _state->Socket->close(ignored);
+    }
+
+    void Finish()
+    {
+        _mgr->_connectionRunning = false;
+        _mgr->_pendingSocket.reset();
+    }
+
+    ClientSocketMgr* _mgr;
+    std::shared_ptr<State> _state;
+};
 
 /*static*/ ClientSocketMgr* ClientSocketMgr::instance()
 {
@@ -31,7 +357,21 @@
 void ClientSocketMgr::Disconnect()
 {
     _stopped = true;
-    _updateTimer->cancel();
+    _enabled.store(false, std::memory_order_release);
+
+    // Not created when Initialize skipped the connect
+    if (_updateTimer)
+        _updateTimer->cancel();
+
+    // Wakes up the connection operation, which ends on _stopped
+    if (_scheduler)
+        _scheduler->Cancel();
+
+    if (_pendingSocket)
+    {
+        boost::system::error_code ignored;
+        _pendingSocket->close(ignored);
+    }
 
     if (_clientSocket && _clientSocket->IsOpen())
         _clientSocket->CloseSocket();
@@ -41,34 +381,50 @@ void ClientSocketMgr::Disconnect()
 
 void ClientSocketMgr::Update()
 {
-    if (_stopped)
+    if (_stopped || !_clientSocket)
         return;
 
-    _updateTimer->expires_from_now(boost::posix_time::milliseconds(1));
-    _updateTimer->async_wait([this](boost::system::error_code const&) { Update(); });
-
-    if (!_clientSocket)
-        return;
+    // Send path, its logs are not forwarded to the discord log channel
+    LogForwardGuard forwardGuard;
 
     if (!_clientSocket->Update())
     {
-        _clientSocket->CloseSocket();
-        _clientSocket.reset();
-        LOG_WARN("server", "> Socket is closed. Start reconnect");
-        ConnectToServer(3);
+        // The connection operation wakes up from the ping wait and reconnects, it schedules the next update
+        OnSocketClosed();
+        _scheduler->Cancel();
         return;
     }
 
-    if (_bufferQueue.IsEmpty())
-        return;
+    ScheduleUpdate();
+
+    // Coalescer -> rate limiter -> socket
+    auto sendToLimiter = [this](int64 channelID, DiscordPacket&& packet)
+    {
+        if (_rateLimiter.IsEnabled())
+            _rateLimiter.AddPacket(channelID, std::move(packet));
+        else
+            SendPacket(std::move(packet));
+    };
 
     DiscordPacket* queuedPacket{ nullptr };
 
-    while (_bufferQueue.GetNextPacket(queuedPacket))
+    while (_bufferQueue.Dequeue(queuedPacket))
     {
-        SendPacket(*queuedPacket);
+        if (auto channelID = DiscordRateLimiter::GetChannelID(*queuedPacket))
+        {
+            if (_coalescer.IsEnabled())
+                _coalescer.AddPacket(*channelID, std::move(*queuedPacket), sendToLimiter);
+            else
+                sendToLimiter(*channelID, std::move(*queuedPacket));
+        }
+        else
+            SendPacket(std::move(*queuedPacket));
+
         delete queuedPacket;
     }
+
+    _coalescer.Update(sendToLimiter);
+    _rateLimiter.Update([this](DiscordPacket const& packet) { SendPacket(packet); });
 }
 
 void ClientSocketMgr::Initialize(Warhead::Asio::IoContext& ioContext)
@@ -79,7 +435,25 @@ void ClientSocketMgr::Initialize(Warhead::Asio::IoContext& ioContext)
         return;
     }
 
+    _accountName = CONF_GET_STR("Discord.Server.Account.Name");
+    _accountKey = CONF_GET_STR("Discord.Server.Account.Key");
+    _serverID = sDiscordConfig->GetOption<int64>("Discord.Server.ID");
+
+    if (!_serverID || _accountName.empty() || _accountKey.empty())
+    {
+        LOG_ERROR("discord.client", "> Empty server id, account name or key. Skip connect");
+        return;
+    }
+
+    _resumeEnabled = sDiscordConfig->GetOption<bool>("Discord.Server.Resume.Enable", true);
+    _historySize = sDiscordConfig->GetOption<uint32>("Discord.Server.Resume.HistorySize", 1000);
+    _pingInterval = Seconds(std::max<uint32>(sDiscordConfig->GetOption<uint32>("Discord.Server.PingInterval", 10), 1));
+
+    _rateLimiter.LoadConfig();
+    _coalescer.LoadConfig();
+
     _updateTimer = std::make_unique<Warhead::Asio::DeadlineTimer>(ioContext);
+    _scheduler = std::make_unique<Warhead::Asio::Scheduler>(ioContext);
 
     Warhead::Asio::Resolver resolver(ioContext);
     auto const& hostName = CONF_GET_STR("Discord.Server.Host");
@@ -92,6 +466,7 @@ void ClientSocketMgr::Initialize(Warhead::Asio::IoContext& ioContext)
     }
 
     _address = std::make_unique<boost::asio::ip::address>(address->address());
+    _enabled.store(true, std::memory_order_release);
 
     ConnectToServer();
 }
@@ -99,10 +474,21 @@ void ClientSocketMgr::Initialize(Warhead::Asio::IoContext& ioContext)
 void ClientSocketMgr::AddPacketToQueue(DiscordPacket const& packet)
 {
     LOG_TRACE("discord.client", "Client->Server: {}", packet.GetOpcode());
-    _bufferQueue.AddPacket(new DiscordPacket(packet));
+    _bufferQueue.Enqueue(new DiscordPacket(packet));
+}
+
+void ClientSocketMgr::AddPacketToQueue(DiscordPacket&& packet)
+{
+    LOG_TRACE("discord.client", "Client->Server: {}", packet.GetOpcode());
+    _bufferQueue.Enqueue(new DiscordPacket(std::move(packet)));
 }
 
 void ClientSocketMgr::SendPacket(DiscordPacket const& packet)
+{
+    SendPacket(DiscordPacket(packet));
+}
+
+void ClientSocketMgr::SendPacket(DiscordPacket&& packet)
 {
     if (!_clientSocket)
     {
@@ -110,58 +496,85 @@ void ClientSocketMgr::SendPacket(DiscordPacket const& packet)
         return;
     }
 
-    _clientSocket->AddPacketToQueue(packet);
+    _clientSocket->AddPacketToQueue(std::move(packet));
 }
 
-void ClientSocketMgr::ConnectToServer(uint32 reconnectCount /*= 1*/)
+void ClientSocketMgr::OnSocketClosed()
 {
-    _updateTimer->cancel();
+    // Resume window of the server starts with the connection loss. The socket exists only after the handshake
+    _resumeExpireTime = std::chrono::steady_clock::now() + _resumeWindow;
+
+    _clientSocket->CloseSocket();
+    _clientSocket->TakeQueuedPackets(_unsentPackets);
+    _clientSocket.reset();
+}
 
+void ClientSocketMgr::ScheduleUpdate()
+{
     _updateTimer->expires_from_now(boost::posix_time::milliseconds(1));
-    _updateTimer->async_wait([this, reconnectCount](boost::system::error_code const&)
+    _updateTimer->async_wait([this](boost::system::error_code const& error)
     {
-        std::lock_guard<std::mutex> _guard(_newConnectLock);
+        // Cancelled by Disconnect
+        if (error != boost::asio::error::operation_aborted)
+            Update();
+    });
+}
 
-        if (_clientSocket && _clientSocket->IsOpen())
-        {
-            LOG_ERROR("discord.client", "> Connection is already exist");
-            return;
-        }
+bool ClientSocketMgr::CanResumeSession() const
+{
+    return _resumeEnabled && !_resumeToken.empty() && std::chrono::steady_clock::now() < _resumeExpireTime;
+}
 
-        if (!_address)
-        {
-            LOG_ERROR("discord.client", "> Could not resolve address. Skip connect");
-            return;
-        }
+void ClientSocketMgr::SetResumeToken(std::string_view token, Seconds window)
+{
+    if (!_resumeEnabled)
+        return;
 
-        LOG_INFO("discord.client", "> Start connect to discord server...");
+    _resumeToken = std::string(token);
+    _resumeWindow = window;
+    _resumeExpireTime = TimePoint::max();
+}
 
-        for (size_t i = 0; i < reconnectCount; i++)
-        {
-            try
-            {
-                tcp::socket clientSocket(Warhead::Asio::get_io_context(*_updateTimer));
-                clientSocket.connect(tcp::endpoint(*_address, sDiscordConfig->GetOption<uint16>("Discord.Server.Port")));
+void ClientSocketMgr::AddSentPacket(DiscordPacket&& packet)
+{
+    // Nothing to replay without a resumable session
+    if (_resumeToken.empty())
+        return;
 
-                _clientSocket = std::make_shared<ClientSocket>(std::move(clientSocket));
-                _clientSocket->Start();
+    // Keep it until the server acknowledges it, to replay after a resume
+    _unackedPackets.emplace_back(std::move(packet));
 
-                _updateTimer->expires_from_now(boost::posix_time::milliseconds(1));
-                _updateTimer->async_wait([this](boost::system::error_code const&) { Update(); });
-                return;
-            }
-            catch (boost::system::system_error const& err)
-            {
-                LOG_WARN("node", "Failed connet. Error {}", err.what());
-            }
+    // Dropping the oldest packet would let a resume claim a sequence the server never acknowledged
+    if (_unackedPackets.size() > _historySize)
+    {
+        LOG_WARN("discord.client", "> Resume history is full ({} packets), the next connect does a full auth", _historySize);
+        ResetSession();
+    }
+}
 
-            if (i + 1 < reconnectCount)
-            {
-                LOG_WARN("node", "> Wait 5 seconds before next connect");
-                std::this_thread::sleep_for(5s);
-            }
-        }
+void ClientSocketMgr::AcknowledgePackets(uint64 sequence)
+{
+    while (_ackedSequence < sequence && !_unackedPackets.empty())
+    {
+        _unackedPackets.pop_front();
+        ++_ackedSequence;
+    }
+}
 
-        Disconnect();
-    });
+void ClientSocketMgr::ResetSession()
+{
+    // New session on server side, packets not acknowledged by the old one are not sent again
+    if (!_unackedPackets.empty())
+        LOG_DEBUG("discord.client", "> Drop {} unacknowledged packets of the old session", _unackedPackets.size());
+
+    _resumeToken.clear();
+    _resumeExpireTime = TimePoint::max();
+    _ackedSequence = 0;
+    _unackedPackets.clear();
+}
+
+void ClientSocketMgr::ConnectToServer(uint32 reconnectCount /*= 1*/)
+{
+    // Runs on the io thread until Disconnect, reconnects by itself
+    Warhead::Asio::post(Warhead::Asio::get_io_context(*_updateTimer), ConnectionOperation(this, reconnectCount));
 }
@@ -19,14 +19,20 @@
 #define _CLIENT_SOCKET_MGR_H_
 
 #include "AsioHacksFwd.h"
+#include "DiscordMessageCoalescer.h"
 #include "DiscordPacket.h"
-#include "PacketQueue.h"
+#include "DiscordRateLimiter.h"
+#include "MPSCQueue.h"
+#include <boost/asio/ip/tcp.hpp>
+#include <atomic>
+#include <deque>
 #include <mutex>
 
 namespace Warhead::Asio
 {
     class IoContext;
     class DeadlineTimer;
+    class Scheduler;
 }
 
 class ClientSocket;
@@ -41,17 +47,65 @@ public:
     void Disconnect();
     void Update();
     void AddPacketToQueue(DiscordPacket const& packet);
+    void AddPacketToQueue(DiscordPacket&& packet);
+
+    // True after successful Initialize, packets added before or when disabled are never sent
+    bool IsEnabled() const { return _enabled.load(std::memory_order_acquire); }
+
+    // Auth info, read once at Initialize
+    std::string const& GetAccountName() const { return _accountName; }
+    std::string const& GetAccountKey() const { return _accountKey; }
+    int64 GetServerID() const { return _serverID; }
+
+    // Session resume
+    bool CanResumeSession() const;
+    std::string const& GetResumeToken() const { return _resumeToken; }
+    uint64 GetAckedSequence() const { return _ackedSequence; }
+    void SetResumeToken(std::string_view token, Seconds window);
+    void AddSentPacket(DiscordPacket&& packet);
+    void AcknowledgePackets(uint64 sequence);
+    void ResetSession();
+
+    // Sent after an accepted resume, before any new packet
+    std::deque<DiscordPacket> const& GetUnackedPackets() const { return _unackedPackets; }
 
 private:
+    class ConnectionOperation;
+
     void SendPacket(DiscordPacket const& packet);
+    void SendPacket(DiscordPacket&& packet);
+    void ScheduleUpdate();
+    void OnSocketClosed();
+
+    std::string _accountName;
+    std::string _accountKey;
+    int64 _serverID{ 0 };
+
+    bool _resumeEnabled{ true };
+    std::string _resumeToken;
+    Seconds _resumeWindow{ 0s };
+    TimePoint _resumeExpireTime{ TimePoint::max() }; // counts from the connection loss
+    uint64 _ackedSequence{ 0 };
+    std::size_t _historySize{ 0 };
+    std::deque<DiscordPacket> _unackedPackets; // only while the session can be resumed
+    Seconds _pingInterval{ 10s };
+
+    // Left in the send queue of a closed socket, sent first by the next one
+    std::deque<DiscordPacket> _unsentPackets;
 
-    std::mutex _newConnectLock;
+    bool _connectionRunning{ false }; // io thread only
+    std::atomic<bool> _enabled{ false };
     std::atomic<bool> _stopped{ false };
     std::unique_ptr<Warhead::Asio::DeadlineTimer> _updateTimer{ nullptr };
+    std::unique_ptr<Warhead::Asio::Scheduler> _scheduler{ nullptr }; // reconnect delay and ping interval
+    std::shared_ptr<boost::asio::ip::tcp::socket> _pendingSocket; // connecting or in the handshake, closed by Disconnect
     std::shared_ptr<ClientSocket> _clientSocket;
     std::unique_ptr<boost::asio::ip::address> _address;
 
-    PacketQueue<DiscordPacket> _bufferQueue;
+    // Filled by any thread, drained only by the io thread in Update. Intrusive, no node allocation per packet
+    MPSCQueue<DiscordPacket, &DiscordPacket::QueueLink> _bufferQueue;
+    DiscordMessageCoalescer _coalescer;
+    DiscordRateLimiter _rateLimiter;
 };
 
 #define sClientSocketMgr ClientSocketMgr::instance()
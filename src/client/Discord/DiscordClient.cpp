@@ -0,0 +1,119 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DiscordClient.h"
+#include "ClientSocketMgr.h"
+#include "DiscordEmbed.h"
+#include "DiscordMessageCoalescer.h"
+#include "Log.h"
+
+/*static*/ DiscordClient* DiscordClient::instance()
+{
+    static DiscordClient instance;
+    return &instance;
+}
+
+bool DiscordClient::Send(int64 channelID, std::string_view text)
+{
+    if (!sClientSocketMgr->IsEnabled())
+        return false;
+
+    if (!channelID || text.empty())
+    {
+        LOG_ERROR("discord.client", "> Skip message with empty channel id or text");
+        return false;
+    }
+
+    for (auto const& part : DiscordMessageCoalescer::SplitText(text))
+    {
+        DiscordPacket packet(CLIENT_SEND_MESSAGE, 8 + part.size() + 1);
+        packet << int64(channelID);
+        packet << part;
+
+        sClientSocketMgr->AddPacketToQueue(std::move(packet));
+    }
+
+    return true;
+}
+
+bool DiscordClient::SendEmbed(int64 channelID, DiscordEmbed const& embed)
+{
+    return SendEmbeds(channelID, { embed });
+}
+
+bool DiscordClient::SendEmbeds(int64 channelID, std::vector<DiscordEmbed> const& embeds)
+{
+    if (!sClientSocketMgr->IsEnabled())
+        return false;
+
+    if (!channelID || embeds.empty() || embeds.size() > DISCORD_MAX_EMBEDS_COUNT)
+    {
+        LOG_ERROR("discord.client", "> Skip embed message with empty channel id or {} embeds", embeds.size());
+        return false;
+    }
+
+    // Text limit is for all embeds of one message, embeds over it go to the next message.
+    // Every packet is built before any is queued, so a bad embed drops the whole call
+    std::vector<DiscordPacket> packets;
+
+    auto buildPacket = [channelID, &embeds, &packets](std::size_t first, std::size_t last)
+    {
+        std::size_t size{ 8 + 1 };
+
+        for (std::size_t i = first; i < last; ++i)
+            size += embeds[i].GetSerializedSize();
+
+        DiscordPacket& packet = packets.emplace_back(CLIENT_SEND_MESSAGE_EMBED, size);
+        packet << int64(channelID);
+        packet << uint8(last - first);
+
+        for (std::size_t i = first; i < last; ++i)
+            embeds[i].WriteTo(packet);
+    };
+
+    try
+    {
+        std::size_t first{ 0 };
+        std::size_t textLength{ 0 };
+
+        for (std::size_t i = 0; i < embeds.size(); ++i)
+        {
+            std::size_t const embedLength = embeds[i].GetTextLength();
+
+            if (i > first && textLength + embedLength > DISCORD_EMBED_MAX_TOTAL_LENGTH)
+            {
+                buildPacket(first, i);
+                first = i;
+                textLength = 0;
+            }
+
+            textLength += embedLength;
+        }
+
+        buildPacket(first, embeds.size());
+    }
+    catch (DiscordEmbedException const& e)
+    {
+        LOG_ERROR("discord.client", "> Skip embed message for channel {}: {}", channelID, e.what());
+        return false;
+    }
+
+    for (auto& packet : packets)
+        sClientSocketMgr->AddPacketToQueue(std::move(packet));
+
+    return true;
+}
@@ -0,0 +1,56 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DISCORD_CLIENT_H_
+#define _DISCORD_CLIENT_H_
+
+#include "Define.h"
+#include <string_view>
+#include <vector>
+
+class DiscordEmbed;
+
+/// Public api for game code. Safe to call from any thread:
+/// packets are built on the calling thread and handed to the io thread
+/// through a lock free queue, so callers never wait for the network thread.
+class WH_CLIENT_API DiscordClient
+{
+    DiscordClient(DiscordClient const&) = delete;
+    DiscordClient(DiscordClient&&) = delete;
+    DiscordClient& operator= (DiscordClient const&) = delete;
+    DiscordClient& operator= (DiscordClient&&) = delete;
+
+    DiscordClient() = default;
+    ~DiscordClient() = default;
+
+public:
+    static DiscordClient* instance();
+
+    /// Sends text message, too long text is split to several messages
+    bool Send(int64 channelID, std::string_view text);
+
+    /// Sends message with one embed
+    bool SendEmbed(int64 channelID, DiscordEmbed const& embed);
+
+    /// Sends message with up to DISCORD_MAX_EMBEDS_COUNT embeds, split to several messages
+    /// if their text is over DISCORD_EMBED_MAX_TOTAL_LENGTH in total
+    bool SendEmbeds(int64 channelID, std::vector<DiscordEmbed> const& embeds);
+};
+
+#define sDiscordClient DiscordClient::instance()
+
+#endif
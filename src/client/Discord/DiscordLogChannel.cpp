@@ -0,0 +1,262 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DiscordLogChannel.h"
+#include "ClientSocketMgr.h"
+#include "DiscordClient.h"
+#include "DiscordMessageCoalescer.h"
+#include "Log.h"
+#include "StringConvert.h"
+#include "ThreadPool.h"
+#include <Poco/Message.h>
+#include <fmt/core.h>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+namespace
+{
+    // Constructed before main, so destroyed after sLog and its channels
+    std::mutex ChannelsLock;
+    std::vector<DiscordLogChannel*> Channels;
+    std::atomic<bool> ClientShutdown{ false };
+}
+
+DiscordLogChannel::DiscordLogChannel(int64 channelID, LogLevel maxLevel, Milliseconds interval, uint32 messagesPerMinute, uint32 maxLines) :
+    _channelID(channelID), _maxLevel(maxLevel), _interval(std::max(interval, Milliseconds(100))),
+    _messagesPerMinute(std::max<uint32>(messagesPerMinute, 1)), _maxLines(std::max<uint32>(maxLines, 1))
+{
+    std::lock_guard<std::mutex> guard(ChannelsLock);
+    Channels.push_back(this);
+}
+
+DiscordLogChannel::~DiscordLogChannel()
+{
+    close();
+
+    std::lock_guard<std::mutex> guard(ChannelsLock);
+    Channels.erase(std::remove(Channels.begin(), Channels.end(), this), Channels.end());
+}
+
+/*static*/ void DiscordLogChannel::Register()
+{
+    sLog->RegisterChannelType(FormattingChannelType::FORMATTING_CHANNEL_TYPE_DISCORD,
+        [](std::string_view channelName, std::vector<std::string_view> const& options) -> Poco::Channel*
+    {
+        auto getOption = [&options](std::size_t position)
+        {
+            return position < options.size() ? options[position] : std::string_view{};
+        };
+
+        auto channelID = Warhead::StringTo<int64>(getOption(0)).value_or(0);
+        if (!channelID)
+        {
+            fmt::print("DiscordLogChannel: Wrong discord channel id for LogChannel.{}\n", channelName);
+            return nullptr;
+        }
+
+        auto level = Warhead::StringTo<uint8>(getOption(1)).value_or(static_cast<uint8>(LogLevel::LOG_LEVEL_ERROR));
+        if (!level || level >= static_cast<uint8>(LogLevel::LOG_LEVEL_MAX))
+        {
+            fmt::print("DiscordLogChannel: Wrong log level {} for LogChannel.{}, use error\n", level, channelName);
+            level = static_cast<uint8>(LogLevel::LOG_LEVEL_ERROR);
+        }
+
+        auto interval = Warhead::StringTo<uint32>(getOption(2)).value_or(2000);
+        auto messagesPerMinute = Warhead::StringTo<uint32>(getOption(3)).value_or(10);
+        auto maxLines = Warhead::StringTo<uint32>(getOption(4)).value_or(1000);
+
+        return new DiscordLogChannel(channelID, LogLevel(level), Milliseconds(interval), messagesPerMinute, maxLines);
+    });
+}
+
+/*static*/ void DiscordLogChannel::Shutdown()
+{
+    std::lock_guard<std::mutex> guard(ChannelsLock);
+
+    // Before the close, a flush job started meanwhile does not send either
+    ClientShutdown.store(true, std::memory_order_release);
+
+    for (DiscordLogChannel* channel : Channels)
+        channel->close();
+}
+
+void DiscordLogChannel::open()
+{
+    std::lock_guard<std::mutex> guard(_lock);
+
+    if (_opened || ClientShutdown.load(std::memory_order_acquire))
+        return;
+
+    _opened = true;
+    _tokens = 1.0;
+    _lastRefill = std::chrono::steady_clock::now();
+    ScheduleFlush();
+}
+
+void DiscordLogChannel::close()
+{
+    std::unique_lock<std::mutex> lock(_lock);
+
+    if (!_opened || _closing)
+        return;
+
+    // No new jobs from here, a delayed one is replaced by the last send below
+    _closing = true;
+
+    if (_flushJob && sThreadPool->Cancel(_flushJob))
+        _flushJob = 0;
+
+    _jobCondition.wait(lock, [this]() { return !_flushJob && !_flushRunning; });
+
+    // One more message if the budget allows, the rest is lost
+    Refill(std::chrono::steady_clock::now());
+
+    if (CanSend())
+    {
+        _tokens -= 1.0;
+        SendMessage(lock);
+    }
+
+    _lines.clear();
+    _droppedLines = 0;
+    _opened = false;
+    _closing = false;
+}
+
+void DiscordLogChannel::log(Poco::Message const& msg)
+{
+    // Send path of the channel itself, or a level not selected for discord
+    if (LogForwardGuard::IsActive() || msg.getPriority() > static_cast<int>(_maxLevel) ||
+        ClientShutdown.load(std::memory_order_acquire))
+        return;
+
+    std::string_view text = msg.getText();
+
+    // Longer lines are cut, one line never takes more than one message
+    if (text.size() >= DISCORD_MAX_MESSAGE_LENGTH)
+        text = DiscordMessageCoalescer::SplitText(text, DISCORD_MAX_MESSAGE_LENGTH - 1).front();
+
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+
+        if (_lines.size() >= _maxLines)
+        {
+            ++_droppedLines;
+            return;
+        }
+
+        _lines.emplace_back(text);
+
+        if (_opened)
+        {
+            ScheduleFlush();
+            return;
+        }
+    }
+
+    open();
+}
+
+void DiscordLogChannel::ScheduleFlush()
+{
+    // A pending or running flush picks up the new lines
+    if (_closing || _flushJob || _flushRunning || (_lines.empty() && !_droppedLines))
+        return;
+
+    // Lines of one interval go out together, and not before the budget has a message for them
+    Milliseconds delay = _interval;
+    if (_tokens < 1.0)
+        delay = std::max(delay, Milliseconds(static_cast<int64>((1.0 - _tokens) * 60000.0 / _messagesPerMinute) + 1));
+
+    _flushJob = sThreadPool->SubmitAfter(delay, [this]() { FlushJob(); });
+}
+
+bool DiscordLogChannel::CanSend() const
+{
+    // Lines wait in the buffer until the client is enabled, the client is not touched after Shutdown
+    return (!_lines.empty() || _droppedLines) && _tokens >= 1.0 &&
+        !ClientShutdown.load(std::memory_order_acquire) && sClientSocketMgr->IsEnabled();
+}
+
+void DiscordLogChannel::Refill(TimePoint now)
+{
+    auto elapsed = std::chrono::duration_cast<Milliseconds>(now - _lastRefill);
+    _lastRefill = now;
+
+    // One minute of budget at most, an idle channel does not save up for a storm
+    _tokens = std::min<double>(_tokens + double(elapsed.count()) * _messagesPerMinute / 60000.0, _messagesPerMinute);
+}
+
+void DiscordLogChannel::FlushJob()
+{
+    std::unique_lock<std::mutex> lock(_lock);
+
+    _flushJob = 0;
+    _flushRunning = true;
+
+    Refill(std::chrono::steady_clock::now());
+
+    if (CanSend())
+    {
+        _tokens -= 1.0;
+        SendMessage(lock);
+    }
+
+    _flushRunning = false;
+
+    // Lines left over or logged during the send
+    ScheduleFlush();
+    _jobCondition.notify_all();
+}
+
+void DiscordLogChannel::SendMessage(std::unique_lock<std::mutex>& lock)
+{
+    std::string text;
+    std::size_t length{ 0 };
+
+    if (_droppedLines)
+    {
+        text = fmt::format("... {} log lines dropped\n", _droppedLines);
+        length = DiscordMessageCoalescer::GetTextLength(text);
+        _droppedLines = 0;
+    }
+
+    while (!_lines.empty())
+    {
+        std::string const& line = _lines.front();
+        std::size_t lineLength = DiscordMessageCoalescer::GetTextLength(line) + 1;
+
+        if (length + lineLength > DISCORD_MAX_MESSAGE_LENGTH)
+            break;
+
+        text.append(line).push_back('\n');
+        length += lineLength;
+        _lines.pop_front();
+    }
+
+    text.pop_back();
+    lock.unlock();
+
+    {
+        // Logs of the client send path must not come back to this channel
+        LogForwardGuard forwardGuard;
+        sDiscordClient->Send(_channelID, text);
+    }
+
+    lock.lock();
+}
@@ -0,0 +1,84 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DISCORD_LOG_CHANNEL_H_
+#define _DISCORD_LOG_CHANNEL_H_
+
+#include "Define.h"
+#include "Duration.h"
+#include <Poco/Channel.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+
+enum class LogLevel : uint8;
+
+/// Log channel type 4, forwards formatted records to a discord channel through DiscordClient.
+/// log() only appends the line to a bounded buffer, a delayed job on the shared ThreadPool joins buffered lines
+/// into one multi-line message an interval after the first one, at most messagesPerMinute messages are sent.
+/// Lines over the buffer limit are dropped and counted, the next message reports them.
+/// Records logged under LogForwardGuard (the discord send path) are never forwarded.
+/// Channels live in sLog, which outlives the client, so Shutdown must close them before the client goes away.
+class WH_CLIENT_API DiscordLogChannel : public Poco::Channel
+{
+public:
+    DiscordLogChannel(int64 channelID, LogLevel maxLevel, Milliseconds interval, uint32 messagesPerMinute, uint32 maxLines);
+
+    /// Registers the channel type in sLog, must be called before sLog->Initialize
+    static void Register();
+
+    /// Closes all channels and stops them from using the client, lines logged later are dropped.
+    /// Must be called before the client is destroyed
+    static void Shutdown();
+
+    void open() override;
+    void close() override;
+    void log(Poco::Message const& msg) override;
+
+protected:
+    ~DiscordLogChannel() override;
+
+private:
+    void ScheduleFlush();
+    void FlushJob();
+    bool CanSend() const;
+    void Refill(TimePoint now);
+    void SendMessage(std::unique_lock<std::mutex>& lock);
+
+    int64 _channelID;
+    LogLevel _maxLevel;
+    Milliseconds _interval;
+    uint32 _messagesPerMinute;
+    uint32 _maxLines;
+
+    std::mutex _lock;
+    std::condition_variable _jobCondition; // close waits for a running flush
+    std::deque<std::string> _lines;
+    uint64 _droppedLines{ 0 };
+
+    // Token bucket, refilled by messagesPerMinute every minute
+    double _tokens{ 0.0 };
+    TimePoint _lastRefill;
+
+    bool _opened{ false };
+    bool _closing{ false };
+    bool _flushRunning{ false };
+    uint64 _flushJob{ 0 }; // pool id of the delayed flush, not started yet
+};
+
+#endif // _DISCORD_LOG_CHANNEL_H_
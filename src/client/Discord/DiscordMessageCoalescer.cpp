@@ -0,0 +1,302 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DiscordMessageCoalescer.h"
+#include "DiscordConfig.h"
+#include "DiscordEmbed.h"
+#include "Log.h"
+#include <algorithm>
+
+namespace
+{
+    // int64 channel id
+    constexpr std::size_t MESSAGE_HEADER_SIZE = sizeof(int64);
+
+    // int64 channel id + uint8 embeds count
+    constexpr std::size_t EMBED_HEADER_SIZE = sizeof(int64) + sizeof(uint8);
+
+    inline bool IsUtf8Continuation(char c)
+    {
+        return (static_cast<uint8>(c) & 0xC0) == 0x80;
+    }
+
+    // Text without channel id and null terminator
+    inline std::string_view GetPacketText(DiscordPacket const& packet)
+    {
+        if (packet.wpos() <= MESSAGE_HEADER_SIZE)
+            return {};
+
+        std::string_view text(reinterpret_cast<char const*>(packet.contents()) + MESSAGE_HEADER_SIZE, packet.wpos() - MESSAGE_HEADER_SIZE);
+
+        if (!text.empty() && text.back() == '\0')
+            text.remove_suffix(1);
+
+        return text;
+    }
+
+    inline DiscordPacket MakeTextPacket(int64 channelID, std::string_view text)
+    {
+        DiscordPacket packet(CLIENT_SEND_MESSAGE, MESSAGE_HEADER_SIZE + text.size() + 1);
+        packet << int64(channelID);
+        packet << text;
+        return packet;
+    }
+}
+
+void DiscordMessageCoalescer::LoadConfig()
+{
+    _enabled = sDiscordConfig->GetOption<bool>("Discord.Coalesce.Enable", true);
+    _linger = Milliseconds(sDiscordConfig->GetOption<uint32>("Discord.Coalesce.Linger", 100));
+}
+
+void DiscordMessageCoalescer::AddPacket(int64 channelID, DiscordPacket&& packet, SendCallback const& send)
+{
+    switch (packet.GetOpcode())
+    {
+        case CLIENT_SEND_MESSAGE:
+            AddTextPacket(channelID, std::move(packet), send);
+            break;
+        case CLIENT_SEND_MESSAGE_EMBED:
+            AddEmbedPacket(channelID, std::move(packet), send);
+            break;
+        default:
+            send(channelID, std::move(packet));
+            break;
+    }
+}
+
+void DiscordMessageCoalescer::Update(SendCallback const& send, bool force /*= false*/)
+{
+    if (_activeChannels.empty())
+        return;
+
+    TimePoint const now = std::chrono::steady_clock::now();
+
+    _activeChannels.erase(std::remove_if(_activeChannels.begin(), _activeChannels.end(), [this, now, force, &send](int64 channelID)
+    {
+        auto itr = _pending.find(channelID);
+        if (itr == _pending.end())
+            return true;
+
+        if (!force && itr->second.FlushTime > now)
+            return false;
+
+        send(channelID, std::move(itr->second.Packet));
+        _pending.erase(itr);
+        return true;
+    }), _activeChannels.end());
+}
+
+/*static*/ std::size_t DiscordMessageCoalescer::GetTextLength(std::string_view text)
+{
+    return std::count_if(text.begin(), text.end(), [](char c) { return !IsUtf8Continuation(c); });
+}
+
+/*static*/ std::vector<std::string_view> DiscordMessageCoalescer::SplitText(std::string_view text, std::size_t maxLength /*= DISCORD_MAX_MESSAGE_LENGTH*/)
+{
+    std::vector<std::string_view> parts;
+
+    while (!text.empty())
+    {
+        std::size_t pos{ 0 };
+        std::size_t length{ 0 };
+        std::size_t lastLineBreak{ std::string_view::npos };
+
+        while (pos < text.size() && length < maxLength)
+        {
+            if (text[pos] == '\n')
+                lastLineBreak = pos;
+
+            // Skip whole utf8 character
+            ++pos;
+            while (pos < text.size() && IsUtf8Continuation(text[pos]))
+                ++pos;
+
+            ++length;
+        }
+
+        // Rest of text is fit
+        if (pos >= text.size())
+        {
+            parts.emplace_back(text);
+            break;
+        }
+
+        // Line ends exactly at the limit
+        if (text[pos] == '\n')
+            lastLineBreak = pos;
+
+        if (lastLineBreak != std::string_view::npos && lastLineBreak > 0)
+        {
+            parts.emplace_back(text.substr(0, lastLineBreak));
+            text.remove_prefix(lastLineBreak + 1);
+        }
+        else
+        {
+            parts.emplace_back(text.substr(0, pos));
+            text.remove_prefix(pos);
+        }
+    }
+
+    return parts;
+}
+
+void DiscordMessageCoalescer::AddTextPacket(int64 channelID, DiscordPacket&& packet, SendCallback const& send)
+{
+    std::string_view text = GetPacketText(packet);
+    std::size_t length = GetTextLength(text);
+
+    // Too long for one message, send full parts now and keep only the last one
+    if (length > DISCORD_MAX_MESSAGE_LENGTH)
+    {
+        if (PendingMessage* pending = GetPending(channelID, CLIENT_SEND_MESSAGE, send))
+        {
+            send(channelID, std::move(pending->Packet));
+            _pending.erase(channelID);
+        }
+
+        auto const& parts = SplitText(text);
+
+        for (std::size_t i = 0; i + 1 < parts.size(); ++i)
+            send(channelID, MakeTextPacket(channelID, parts[i]));
+
+        SetPending(channelID, MakeTextPacket(channelID, parts.back()), GetTextLength(parts.back()));
+        return;
+    }
+
+    PendingMessage* pending = GetPending(channelID, CLIENT_SEND_MESSAGE, send);
+    if (!pending)
+    {
+        SetPending(channelID, std::move(packet), length);
+        return;
+    }
+
+    // + line break
+    if (pending->Length + 1 + length > DISCORD_MAX_MESSAGE_LENGTH)
+    {
+        send(channelID, std::move(pending->Packet));
+        _pending.erase(channelID);
+        SetPending(channelID, std::move(packet), length);
+        return;
+    }
+
+    // Replace null terminator with line break and append the new text
+    DiscordPacket& merged = pending->Packet;
+
+    if (merged.wpos() > MESSAGE_HEADER_SIZE && merged.contents()[merged.wpos() - 1] == '\0')
+        merged.wpos(merged.wpos() - 1);
+    else
+    {
+        // No terminator to replace, rebuild the packet from its channel id and text
+        std::string_view pendingText = GetPacketText(merged);
+        DiscordPacket rebuilt(CLIENT_SEND_MESSAGE, MESSAGE_HEADER_SIZE + pendingText.size() + 1 + text.size() + 1);
+        rebuilt << int64(channelID);
+
+        if (!pendingText.empty())
+            rebuilt.append(pendingText.data(), pendingText.size());
+
+        merged = std::move(rebuilt);
+    }
+
+    merged.append<char>('\n');
+
+    if (!text.empty())
+        merged.append(text.data(), text.size());
+
+    merged.append<uint8>(0);
+    pending->Length += 1 + length;
+}
+
+void DiscordMessageCoalescer::AddEmbedPacket(int64 channelID, DiscordPacket&& packet, SendCallback const& send)
+{
+    if (packet.wpos() < EMBED_HEADER_SIZE)
+    {
+        send(channelID, std::move(packet));
+        return;
+    }
+
+    std::size_t count = packet.read<uint8>(MESSAGE_HEADER_SIZE);
+    auto textLength = DiscordEmbed::GetTextLength(packet, EMBED_HEADER_SIZE, count);
+
+    PendingMessage* pending = GetPending(channelID, CLIENT_SEND_MESSAGE_EMBED, send);
+
+    // Broken data is not merged, the server rejects it alone
+    if (!textLength)
+    {
+        if (pending)
+        {
+            send(channelID, std::move(pending->Packet));
+            _pending.erase(channelID);
+        }
+
+        send(channelID, std::move(packet));
+        return;
+    }
+
+    if (!pending)
+    {
+        SetPending(channelID, std::move(packet), count, *textLength);
+        return;
+    }
+
+    // Total text limit is for all embeds of the message
+    if (pending->Length + count > DISCORD_MAX_EMBEDS_COUNT || pending->TextLength + *textLength > DISCORD_EMBED_MAX_TOTAL_LENGTH)
+    {
+        send(channelID, std::move(pending->Packet));
+        _pending.erase(channelID);
+        SetPending(channelID, std::move(packet), count, *textLength);
+        return;
+    }
+
+    // Embeds are self delimited, only the count needs update
+    DiscordPacket& merged = pending->Packet;
+    pending->Length += count;
+    pending->TextLength += *textLength;
+    merged.put<uint8>(MESSAGE_HEADER_SIZE, uint8(pending->Length));
+
+    if (packet.wpos() > EMBED_HEADER_SIZE)
+        merged.append(packet.contents() + EMBED_HEADER_SIZE, packet.wpos() - EMBED_HEADER_SIZE);
+}
+
+DiscordMessageCoalescer::PendingMessage* DiscordMessageCoalescer::GetPending(int64 channelID, uint16 opcode, SendCallback const& send)
+{
+    auto itr = _pending.find(channelID);
+    if (itr == _pending.end())
+        return nullptr;
+
+    // Keep order of messages in channel, other type can't be merged
+    if (itr->second.Packet.GetOpcode() != opcode)
+    {
+        send(channelID, std::move(itr->second.Packet));
+        _pending.erase(itr);
+        return nullptr;
+    }
+
+    return &itr->second;
+}
+
+void DiscordMessageCoalescer::SetPending(int64 channelID, DiscordPacket&& packet, std::size_t length, std::size_t textLength /*= 0*/)
+{
+    if (std::find(_activeChannels.begin(), _activeChannels.end(), channelID) == _activeChannels.end())
+        _activeChannels.emplace_back(channelID);
+
+    PendingMessage& pending = _pending[channelID];
+    pending.Packet = std::move(packet);
+    pending.Length = length;
+    pending.TextLength = textLength;
+    pending.FlushTime = std::chrono::steady_clock::now() + _linger;
+}
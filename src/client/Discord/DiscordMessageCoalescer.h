@@ -0,0 +1,72 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DISCORD_MESSAGE_COALESCER_H_
+#define _DISCORD_MESSAGE_COALESCER_H_
+
+#include "DiscordPacket.h"
+#include <functional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/// Merges consecutive messages for one channel which came in the linger window
+/// into one message up to discord limits (2000 characters of text, or 10 embeds with up to
+/// 6000 characters in total), and splits too long text messages.
+class WH_CLIENT_API DiscordMessageCoalescer
+{
+    struct PendingMessage
+    {
+        DiscordPacket Packet;
+        std::size_t Length{ 0 };     // characters for text, embeds count for embed message
+        std::size_t TextLength{ 0 }; // embed message text characters, for DISCORD_EMBED_MAX_TOTAL_LENGTH
+        TimePoint FlushTime;
+    };
+
+public:
+    using SendCallback = std::function<void(int64 /*channelID*/, DiscordPacket&&)>;
+
+    void LoadConfig();
+
+    bool IsEnabled() const { return _enabled; }
+
+    void AddPacket(int64 channelID, DiscordPacket&& packet, SendCallback const& send);
+
+    /// Sends messages with expired linger window, or all of them if force
+    void Update(SendCallback const& send, bool force = false);
+
+    /// Count of characters (code points) in utf8 text
+    static std::size_t GetTextLength(std::string_view text);
+
+    /// Splits text to parts with up to maxLength characters.
+    /// Cuts at the last line break of each part if any, never inside an utf8 character.
+    static std::vector<std::string_view> SplitText(std::string_view text, std::size_t maxLength = DISCORD_MAX_MESSAGE_LENGTH);
+
+private:
+    void AddTextPacket(int64 channelID, DiscordPacket&& packet, SendCallback const& send);
+    void AddEmbedPacket(int64 channelID, DiscordPacket&& packet, SendCallback const& send);
+    PendingMessage* GetPending(int64 channelID, uint16 opcode, SendCallback const& send);
+    void SetPending(int64 channelID, DiscordPacket&& packet, std::size_t length, std::size_t textLength = 0);
+
+    bool _enabled{ true };
+    Milliseconds _linger{ 100ms };
+
+    std::unordered_map<int64, PendingMessage> _pending;
+    std::vector<int64> _activeChannels;
+};
+
+#endif
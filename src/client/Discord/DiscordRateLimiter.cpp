@@ -0,0 +1,152 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DiscordRateLimiter.h"
+#include "DiscordConfig.h"
+#include "Log.h"
+#include "StringConvert.h"
+#include "Tokenize.h"
+#include <algorithm>
+
+void DiscordRateLimiter::LoadConfig()
+{
+    _enabled = sDiscordConfig->GetOption<bool>("Discord.RateLimit.Enable", true);
+    _burst = std::max<uint32>(1, sDiscordConfig->GetOption<uint32>("Discord.RateLimit.Burst", 5));
+    _period = Milliseconds(sDiscordConfig->GetOption<uint32>("Discord.RateLimit.Period", 5000));
+    _maxQueueSize = sDiscordConfig->GetOption<uint32>("Discord.RateLimit.MaxQueueSize", 1000);
+
+    _channelRates.clear();
+
+    // Format: "channel:burst:period channel:burst:period"
+    std::string const& channelRates = CONF_GET_STR("Discord.RateLimit.Channels");
+
+    for (auto const& rate : Warhead::Tokenize(channelRates, ' ', false))
+    {
+        auto const& tokens = Warhead::Tokenize(rate, ':', false);
+        if (tokens.size() != 3)
+        {
+            LOG_ERROR("discord.client", "> DiscordRateLimiter: Bad channel rate '{}'. Skip", rate);
+            continue;
+        }
+
+        auto channelID = Warhead::StringTo<int64>(tokens[0]);
+        auto burst = Warhead::StringTo<uint32>(tokens[1]);
+        auto period = Warhead::StringTo<uint32>(tokens[2]);
+
+        if (!channelID || !burst || !*burst || !period)
+        {
+            LOG_ERROR("discord.client", "> DiscordRateLimiter: Bad channel rate '{}'. Skip", rate);
+            continue;
+        }
+
+        _channelRates[*channelID] = { *burst, Milliseconds(*period) };
+    }
+
+    // Apply new rates to existing buckets
+    for (auto& [channelID, bucket] : _buckets)
+    {
+        auto const& itr = _channelRates.find(channelID);
+        bucket.Burst = itr != _channelRates.end() ? itr->second.first : _burst;
+        bucket.Period = itr != _channelRates.end() ? itr->second.second : _period;
+
+        while (bucket.SendTimes.size() > bucket.Burst)
+            bucket.SendTimes.pop_front();
+    }
+}
+
+Optional<int64> DiscordRateLimiter::GetChannelID(DiscordPacket const& packet)
+{
+    if (packet.GetOpcode() != CLIENT_SEND_MESSAGE && packet.GetOpcode() != CLIENT_SEND_MESSAGE_EMBED)
+        return {};
+
+    if (packet.size() < sizeof(int64))
+        return {};
+
+    return packet.read<int64>(0);
+}
+
+void DiscordRateLimiter::AddPacket(int64 channelID, DiscordPacket&& packet)
+{
+    ChannelBucket& bucket = GetBucket(channelID);
+
+    if (bucket.Queue.empty())
+        _activeChannels.emplace_back(channelID);
+
+    if (_maxQueueSize && bucket.Queue.size() >= _maxQueueSize)
+    {
+        LOG_WARN("discord.client", "> DiscordRateLimiter: Queue for channel {} is full. Drop oldest message", channelID);
+        bucket.Queue.pop_front();
+    }
+
+    bucket.Queue.emplace_back(std::move(packet));
+}
+
+void DiscordRateLimiter::Update(SendCallback const& send)
+{
+    if (_activeChannels.empty())
+        return;
+
+    TimePoint const now = std::chrono::steady_clock::now();
+
+    _activeChannels.erase(std::remove_if(_activeChannels.begin(), _activeChannels.end(), [this, now, &send](int64 channelID)
+    {
+        ChannelBucket& bucket = _buckets.at(channelID);
+
+        while (!bucket.Queue.empty() && CanSend(bucket, now))
+        {
+            send(bucket.Queue.front());
+            bucket.Queue.pop_front();
+            bucket.SendTimes.emplace_back(now);
+        }
+
+        return bucket.Queue.empty();
+    }), _activeChannels.end());
+}
+
+std::size_t DiscordRateLimiter::GetQueuedCount() const
+{
+    std::size_t count{ 0 };
+
+    for (int64 channelID : _activeChannels)
+        count += _buckets.at(channelID).Queue.size();
+
+    return count;
+}
+
+DiscordRateLimiter::ChannelBucket& DiscordRateLimiter::GetBucket(int64 channelID)
+{
+    auto itr = _buckets.find(channelID);
+    if (itr != _buckets.end())
+        return itr->second;
+
+    ChannelBucket& bucket = _buckets[channelID];
+
+    auto const& rateItr = _channelRates.find(channelID);
+    bucket.Burst = rateItr != _channelRates.end() ? rateItr->second.first : _burst;
+    bucket.Period = rateItr != _channelRates.end() ? rateItr->second.second : _period;
+
+    return bucket;
+}
+
+/*static*/ bool DiscordRateLimiter::CanSend(ChannelBucket& bucket, TimePoint now)
+{
+    // Sends older than one period no longer count
+    while (!bucket.SendTimes.empty() && now - bucket.SendTimes.front() >= bucket.Period)
+        bucket.SendTimes.pop_front();
+
+    return bucket.SendTimes.size() < bucket.Burst;
+}
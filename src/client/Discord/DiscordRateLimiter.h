@@ -0,0 +1,72 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DISCORD_RATE_LIMITER_H_
+#define _DISCORD_RATE_LIMITER_H_
+
+#include "DiscordPacket.h"
+#include "Optional.h"
+#include <deque>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+/// Limit per discord channel in front of the send queue: at most Burst messages in any Period,
+/// checked against the times of the last Burst sends, so a burst is never followed by a refill in the same period.
+/// Messages of a throttled channel are held here, other channels keep sending.
+class WH_CLIENT_API DiscordRateLimiter
+{
+    struct ChannelBucket
+    {
+        uint32 Burst{ 0 };
+        Milliseconds Period{ 0ms };
+        std::deque<TimePoint> SendTimes; // up to Burst last sends, oldest first
+        std::deque<DiscordPacket> Queue;
+    };
+
+public:
+    using SendCallback = std::function<void(DiscordPacket const&)>;
+
+    void LoadConfig();
+
+    bool IsEnabled() const { return _enabled; }
+
+    /// Channel id of CLIENT_SEND_MESSAGE and CLIENT_SEND_MESSAGE_EMBED, empty for other opcodes
+    static Optional<int64> GetChannelID(DiscordPacket const& packet);
+
+    void AddPacket(int64 channelID, DiscordPacket&& packet);
+
+    /// Sends all queued packets allowed by the channel buckets
+    void Update(SendCallback const& send);
+
+    std::size_t GetQueuedCount() const;
+
+private:
+    ChannelBucket& GetBucket(int64 channelID);
+    static bool CanSend(ChannelBucket& bucket, TimePoint now);
+
+    bool _enabled{ true };
+    uint32 _burst{ 5 };
+    Milliseconds _period{ 5s };
+    std::size_t _maxQueueSize{ 1000 };
+    std::unordered_map<int64 /*channel*/, std::pair<uint32 /*burst*/, Milliseconds /*period*/>> _channelRates;
+
+    std::unordered_map<int64, ChannelBucket> _buckets;
+    std::vector<int64> _activeChannels;
+};
+
+#endif
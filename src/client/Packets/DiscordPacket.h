@@ -22,6 +22,7 @@
 #include "Define.h"
 #include "Duration.h"
 #include "DiscordSharedDefines.h"
+#include <atomic>
 
 class DiscordPacket : public ByteBuffer
 {
@@ -78,6 +79,9 @@ public:
 
     [[nodiscard]] TimePoint GetReceivedTime() const { return m_receivedTime; }
 
+    // Link for MPSCQueue<DiscordPacket, &DiscordPacket::QueueLink>, never copied or moved with the packet
+    std::atomic<DiscordPacket*> QueueLink{ nullptr };
+
 protected:
     uint16 m_opcode{ NULL_OPCODE };
     TimePoint m_receivedTime; // only set for a specific set of opcodes, for performance reasons.
@@ -0,0 +1,97 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AsyncOperations_h__
+#define AsyncOperations_h__
+
+#include "DeadlineTimer.h"
+#include "Duration.h"
+#include "MessageBuffer.h"
+#include <boost/asio/compose.hpp>
+#include <boost/asio/coroutine.hpp>
+#include <boost/asio/read.hpp>
+#include <optional>
+
+#include <boost/asio/yield.hpp>
+
+// Composed operations written as stackless coroutines (boost::asio::coroutine), usable with any completion token.
+// Every step is a yield on an async call, the operation object is moved into it and resumed by its completion.
+namespace Warhead::Asio
+{
+    /// Waits for duration on timer, completes with operation_aborted if the timer is cancelled meanwhile.
+    /// Signature: void(boost::system::error_code)
+    template<typename CompletionToken>
+    auto AsyncDelay(DeadlineTimer& timer, Milliseconds duration, CompletionToken&& token)
+    {
+        return boost::asio::async_compose<CompletionToken, void(boost::system::error_code)>(
+            [&timer, duration, coroutine = boost::asio::coroutine()](auto& self, boost::system::error_code error = {}) mutable
+        {
+            reenter (coroutine)
+            {
+                timer.expires_from_now(boost::posix_time::milliseconds(duration.count()));
+                yield timer.async_wait(std::move(self));
+                self.complete(error);
+            }
+        }, token, timer);
+    }
+
+    /// Reads one length prefixed frame: header.GetBufferSize() bytes of header, then the payload,
+    /// its size is frameSize(header bytes) - empty for a malformed header, the operation fails with invalid_argument.
+    /// Buffers must outlive the operation, payload holds the frame on success. Signature: void(boost::system::error_code)
+    template<typename AsyncReadStream, typename FrameSize, typename CompletionToken>
+    auto AsyncReadFrame(AsyncReadStream& stream, MessageBuffer& header, MessageBuffer& payload, FrameSize frameSize, CompletionToken&& token)
+    {
+        return boost::asio::async_compose<CompletionToken, void(boost::system::error_code)>(
+            [&stream, &header, &payload, frameSize = std::move(frameSize), coroutine = boost::asio::coroutine()]
+            (auto& self, boost::system::error_code error = {}, std::size_t transferred = 0) mutable
+        {
+            reenter (coroutine)
+            {
+                header.Reset();
+                yield boost::asio::async_read(stream, boost::asio::buffer(header.GetWritePointer(), header.GetRemainingSpace()), std::move(self));
+                if (error)
+                    return self.complete(error);
+
+                header.WriteCompleted(transferred);
+
+                {
+                    std::optional<std::size_t> size = frameSize(header.GetReadPointer());
+                    if (!size)
+                        return self.complete(boost::asio::error::invalid_argument);
+
+                    payload.Reset();
+                    payload.Resize(*size);
+                }
+
+                if (payload.GetRemainingSpace())
+                {
+                    yield boost::asio::async_read(stream, boost::asio::buffer(payload.GetWritePointer(), payload.GetRemainingSpace()), std::move(self));
+                    if (error)
+                        return self.complete(error);
+
+                    payload.WriteCompleted(transferred);
+                }
+
+                self.complete(error);
+            }
+        }, token, stream);
+    }
+}
+
+#include <boost/asio/unyield.hpp>
+
+#endif // AsyncOperations_h__
@@ -0,0 +1,72 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef Scheduler_h__
+#define Scheduler_h__
+
+#include "AsyncOperations.h"
+#include "IoContext.h"
+#include <list>
+
+#include <boost/asio/yield.hpp>
+
+namespace Warhead::Asio
+{
+    /// Delayed completions on one io context, any number may be pending.
+    /// Cancel completes all pending ones with operation_aborted. Not thread safe, use it from the io thread,
+    /// and keep it alive until the pending completions ran.
+    class Scheduler
+    {
+    public:
+        explicit Scheduler(boost::asio::io_context& ioContext) : _ioContext(ioContext) { }
+
+        Scheduler(Scheduler const&) = delete;
+        Scheduler& operator=(Scheduler const&) = delete;
+
+        /// Completes after duration. Signature: void(boost::system::error_code)
+        template<typename CompletionToken>
+        auto After(Milliseconds duration, CompletionToken&& token)
+        {
+            auto timer = _timers.emplace(_timers.end(), _ioContext);
+
+            return boost::asio::async_compose<CompletionToken, void(boost::system::error_code)>(
+                [this, timer, duration, coroutine = boost::asio::coroutine()](auto& self, boost::system::error_code error = {}) mutable
+            {
+                reenter (coroutine)
+                {
+                    yield AsyncDelay(*timer, duration, std::move(self));
+                    _timers.erase(timer);
+                    self.complete(error);
+                }
+            }, token, _ioContext);
+        }
+
+        void Cancel()
+        {
+            for (DeadlineTimer& timer : _timers)
+                timer.cancel();
+        }
+
+    private:
+        boost::asio::io_context& _ioContext;
+        std::list<DeadlineTimer> _timers; // one per pending completion
+    };
+}
+
+#include <boost/asio/unyield.hpp>
+
+#endif // Scheduler_h__
@@ -17,6 +17,7 @@
 
 #include "Errors.h"
 #include "Duration.h"
+#include "Log.h"
 #include <cstdio>
 #include <cstdlib>
 #include <thread>
@@ -107,6 +108,7 @@ namespace
 void Warhead::Assert(std::string_view file, int line, std::string_view function, std::string const& debugInfo, std::string_view message, std::string const& fmtMessage /*= ""*/)
 {
     std::string formattedMessage = MakeMessage("ASSERTION FAILED", file, line, function, message, fmtMessage, debugInfo);
+    sLog->Flush();
     fprintf(stderr, "%s", formattedMessage.c_str());
     fflush(stderr);
     Crash(formattedMessage.c_str());
@@ -115,6 +117,7 @@ void Warhead::Assert(std::string_view file, int line, std::string_view function,
 void Warhead::Fatal(std::string_view file, int line, std::string_view function, std::string_view message, std::string const& fmtMessage /*= ""*/)
 {
     std::string formattedMessage = MakeMessage("FATAL ERROR", file, line, function, message, fmtMessage);
+    sLog->Flush();
 
     fprintf(stderr, "%s", formattedMessage.c_str());
     fflush(stderr);
@@ -126,6 +129,7 @@ void Warhead::Fatal(std::string_view file, int line, std::string_view function,
 void Warhead::Error(std::string_view file, int line, std::string_view function, std::string_view message)
 {
     std::string formattedMessage = MakeMessage("ERROR", file, line, function, message);
+    sLog->Flush();
 
     fprintf(stderr, "%s", formattedMessage.c_str());
     fflush(stderr);
@@ -143,6 +147,7 @@ void Warhead::Warning(std::string_view file, int line, std::string_view function
 void Warhead::Abort(std::string_view file, int line, std::string_view function, std::string const& fmtMessage /*= ""*/)
 {
     std::string formattedMessage = MakeAbortMessage(file, line, function, fmtMessage);
+    sLog->Flush();
     fprintf(stderr, "%s", formattedMessage.c_str());
     fflush(stderr);
     Crash(formattedMessage.c_str());
@@ -17,14 +17,23 @@
 
 #include "Log.h"
 #include "Config.h"
+#include "Duration.h"
+#include "LogAsyncWriter.h"
+#include "LogCompressor.h"
+#include "LogFileChannel.h"
+#include "LogPatternFormatter.h"
 #include "StringConvert.h"
+#include "ThreadPool.h"
 #include "Tokenize.h"
 #include <Poco/AutoPtr.h>
 #include <Poco/FileChannel.h>
 #include <Poco/FormattingChannel.h>
 #include <Poco/Logger.h>
-#include <Poco/PatternFormatter.h>
 #include <Poco/SplitterChannel.h>
+#include <Poco/Thread.h>
+#include <Poco/Timestamp.h>
+#include <algorithm>
+#include <chrono>
 #include <sstream>
 #include <unordered_map>
 #include <fmt/core.h>
@@ -53,8 +62,55 @@ namespace
     constexpr auto PREFIX_CHANNEL_LENGTH = 11;    
 }
 
+namespace
+{
+    thread_local fmt::memory_buffer LogFormatBuffer;
+    thread_local bool LogFormatBufferInUse = false;
+    thread_local bool LogForwardDisabled = false;
+}
+
+LogForwardGuard::LogForwardGuard(bool active /*= true*/) :
+    _previous(LogForwardDisabled)
+{
+    LogForwardDisabled = _previous || active;
+}
+
+LogForwardGuard::~LogForwardGuard()
+{
+    LogForwardDisabled = _previous;
+}
+
+/*static*/ bool LogForwardGuard::IsActive()
+{
+    return LogForwardDisabled;
+}
+
+Log::FormatBuffer::FormatBuffer()
+{
+    if (LogFormatBufferInUse)
+    {
+        _nested = std::make_unique<fmt::memory_buffer>();
+        _buffer = _nested.get();
+        return;
+    }
+
+    LogFormatBufferInUse = true;
+    LogFormatBuffer.clear();
+    _buffer = &LogFormatBuffer;
+}
+
+Log::FormatBuffer::~FormatBuffer()
+{
+    if (!_nested)
+        LogFormatBufferInUse = false;
+}
+
 Log::Log()
 {
+    // Pool and compressor outlive the channels, they wait for their jobs on close
+    Warhead::ThreadPool::instance();
+    LogCompressor::instance();
+
     Clear();
 }
 
@@ -71,10 +127,35 @@ Log* Log::instance()
 
 void Log::Clear()
 {
+    // Stop the writer first, it drains queued records into loggers that are about to be destroyed.
+    // Joined before the reset, the writer thread reads _asyncWriter when it writes rate limit summaries
+    if (_asyncWriter)
+        _asyncWriter->Stop();
+
+    _asyncWriter.reset();
+
+    // Disable every call site before the loggers go away
+    {
+        std::lock_guard<std::mutex> guard(_loggerHandlesLock);
+
+        for (auto const& [filter, handle] : _loggerHandles)
+        {
+            handle->Level.store(LogLevel::LOG_LEVEL_DISABLED, std::memory_order_relaxed);
+            handle->Binary.store(nullptr, std::memory_order_relaxed);
+            handle->Text.store(false, std::memory_order_relaxed);
+            handle->RateLimit.store(0, std::memory_order_relaxed);
+            handle->Logger.store(nullptr, std::memory_order_release);
+        }
+    }
+
     // Clear all loggers
     Logger::shutdown();
 
     _channelStore.clear();
+    _loggerBinaryChannels.clear();
+    _loggerTextChannels.clear();
+    _loggerRateLimits.clear();
+    _binaryChannels.clear();
 }
 
 void Log::Initialize()
@@ -82,6 +163,11 @@ void Log::Initialize()
     LoadFromConfig();
 }
 
+void Log::RegisterChannelType(FormattingChannelType type, LogChannelFactory factory)
+{
+    _channelFactories[static_cast<uint8>(type)] = std::move(factory);
+}
+
 void Log::LoadFromConfig()
 {
     highestLogLevel = LogLevel::LOG_LEVEL_FATAL;
@@ -90,10 +176,47 @@ void Log::LoadFromConfig()
     InitLogsDir();
     ReadChannelsFromConfig();
     ReadLoggersFromConfig();
+    RefreshLoggerHandles();
+    InitAsyncWriter();
+    InitCompressor();
 
     _channelStore.clear();
 }
 
+void Log::InitAsyncWriter()
+{
+    if (!sConfigMgr->GetOption<bool>("Log.Async.Enable", true))
+        return;
+
+    auto queueSize = sConfigMgr->GetOption<uint32>("Log.Async.QueueSize", 8192);
+    auto policy = sConfigMgr->GetOption<uint8>("Log.Async.OverflowPolicy", static_cast<uint8>(LogOverflowPolicy::LOG_OVERFLOW_POLICY_DROP_AND_COUNT));
+
+    if (policy >= static_cast<uint8>(LogOverflowPolicy::LOG_OVERFLOW_POLICY_MAX))
+    {
+        fmt::print("Log::InitAsyncWriter: Wrong overflow policy {}, use drop and count\n", policy);
+        policy = static_cast<uint8>(LogOverflowPolicy::LOG_OVERFLOW_POLICY_DROP_AND_COUNT);
+    }
+
+    _asyncWriter = std::make_unique<LogAsyncWriter>(std::max<uint32>(queueSize, 64), static_cast<LogOverflowPolicy>(policy));
+}
+
+void Log::InitCompressor()
+{
+    sLogCompressor->Configure(
+        sConfigMgr->GetOption<uint32>("Log.Compress.Threads", 1),
+        sConfigMgr->GetOption<int32>("Log.Compress.Nice", 10),
+        sConfigMgr->GetOption<int32>("Log.Compress.Level", 6));
+}
+
+void Log::Flush()
+{
+    if (_asyncWriter)
+        _asyncWriter->Flush();
+
+    for (auto const& [name, channel] : _binaryChannels)
+        channel->Flush();
+}
+
 void Log::InitLogsDir()
 {
     m_logsDir = sConfigMgr->GetOption<std::string>("LogsDir", "");
@@ -155,6 +278,165 @@ bool Log::ShouldLog(std::string_view type, LogLevel level) const
     return logLevel != LogLevel::LOG_LEVEL_DISABLED && logLevel >= level;
 }
 
+LogLoggerHandle const* Log::GetLoggerHandle(std::string_view filter)
+{
+    std::lock_guard<std::mutex> guard(_loggerHandlesLock);
+
+    auto& handle = _loggerHandles[std::string(filter)];
+    if (!handle)
+    {
+        handle = std::make_unique<LogLoggerHandle>(filter);
+        ResolveLoggerHandle(*handle);
+    }
+
+    return handle.get();
+}
+
+void Log::ResolveLoggerHandle(LogLoggerHandle& handle)
+{
+    Logger* logger = GetLoggerByType(handle.Name);
+    LogBinaryWriter* binary = nullptr;
+    bool text = false;
+    std::pair<uint32, uint32> rateLimit{ 0, 0 };
+
+    if (logger)
+    {
+        auto const& binaryItr = _loggerBinaryChannels.find(logger->name());
+        if (binaryItr != _loggerBinaryChannels.end())
+            binary = binaryItr->second;
+
+        auto const& textItr = _loggerTextChannels.find(logger->name());
+        text = textItr == _loggerTextChannels.end() || textItr->second;
+
+        auto const& rateItr = _loggerRateLimits.find(logger->name());
+        if (rateItr != _loggerRateLimits.end())
+            rateLimit = rateItr->second;
+    }
+
+    handle.Level.store(logger ? LogLevel(logger->getLevel()) : LogLevel::LOG_LEVEL_DISABLED, std::memory_order_relaxed);
+    handle.Binary.store(binary, std::memory_order_relaxed);
+    handle.Text.store(text, std::memory_order_relaxed);
+    handle.RateWindow.store(rateLimit.second, std::memory_order_relaxed);
+    handle.RateLimit.store(rateLimit.first, std::memory_order_relaxed);
+    handle.Logger.store(logger, std::memory_order_release);
+}
+
+int64 Log::GetRateLimitTime()
+{
+    return std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool Log::RateLimitExceeded(LogCallSite& site, LogLoggerHandle const* handle, LogLevel level)
+{
+    int64 now = GetRateLimitTime();
+    int64 windowStart = site.RateWindowStart.load(std::memory_order_relaxed);
+    uint32 window = handle->RateWindow.load(std::memory_order_relaxed);
+
+    if (now - windowStart < window)
+    {
+        // First suppressed message of the site, report it even if the site does not fire again
+        if (!site.RateSuppressed.load(std::memory_order_relaxed) && !site.RateSuppressed.exchange(true, std::memory_order_relaxed))
+        {
+            std::lock_guard<std::mutex> guard(_rateLimitedSitesLock);
+            _rateLimitedSites.push_back({ &site, handle, level });
+        }
+
+        return false;
+    }
+
+    // Window is over, one thread starts the next one and reports what was suppressed
+    if (!site.RateWindowStart.compare_exchange_strong(windowStart, now, std::memory_order_relaxed))
+        return false;
+
+    uint32 count = site.RateCount.exchange(1, std::memory_order_relaxed);
+    uint32 limit = handle->RateLimit.load(std::memory_order_relaxed);
+
+    // Count includes this message
+    if (count > limit + 1)
+        WriteRateLimitSummary(site, handle, level, count - limit - 1, limit, window);
+
+    return true;
+}
+
+void Log::WriteRateLimitSummaries()
+{
+    int64 now = GetRateLimitTime();
+    int64 nextCheck = _nextRateLimitCheck.load(std::memory_order_relaxed);
+
+    if (now < nextCheck || !_nextRateLimitCheck.compare_exchange_strong(nextCheck, now + 1, std::memory_order_relaxed))
+        return;
+
+    struct Summary
+    {
+        RateLimitedSite Site;
+        uint32 Suppressed;
+        uint32 Limit;
+        uint32 Window;
+    };
+
+    std::vector<Summary> summaries;
+
+    {
+        std::lock_guard<std::mutex> guard(_rateLimitedSitesLock);
+
+        auto itr = std::remove_if(_rateLimitedSites.begin(), _rateLimitedSites.end(), [&](RateLimitedSite const& entry)
+        {
+            LogCallSite& site = *entry.Site;
+            uint32 limit = entry.Handle->RateLimit.load(std::memory_order_relaxed);
+            uint32 window = entry.Handle->RateWindow.load(std::memory_order_relaxed);
+            int64 windowStart = site.RateWindowStart.load(std::memory_order_relaxed);
+
+            if (limit && now - windowStart < window)
+                return false;
+
+            // Same hand over as in RateLimitExceeded, the next message of the site starts a new window
+            if (site.RateWindowStart.compare_exchange_strong(windowStart, now, std::memory_order_relaxed))
+            {
+                uint32 count = site.RateCount.exchange(0, std::memory_order_relaxed);
+                if (limit && count > limit)
+                    summaries.push_back({ entry, count - limit, limit, window });
+            }
+
+            site.RateSuppressed.store(false, std::memory_order_relaxed);
+            return true;
+        });
+
+        _rateLimitedSites.erase(itr, _rateLimitedSites.end());
+    }
+
+    // Written without the lock, Write may get back here
+    for (Summary const& summary : summaries)
+        WriteRateLimitSummary(*summary.Site.Site, summary.Site.Handle, summary.Site.Level, summary.Suppressed, summary.Limit, summary.Window);
+}
+
+void Log::WriteRateLimitSummary(LogCallSite const& site, LogLoggerHandle const* handle, LogLevel level, uint32 suppressed, uint32 limit, uint32 window)
+{
+    // Counted per call site, the suppressed messages share the format but not the arguments
+    Write(handle, level, fmt::format("{}:{}: {} messages suppressed (limit {} per {}s): \"{}\"", site.File, site.Line, suppressed, limit, window, site.Format));
+}
+
+void Log::RefreshLoggerHandles()
+{
+    std::lock_guard<std::mutex> guard(_loggerHandlesLock);
+
+    for (auto const& [filter, handle] : _loggerHandles)
+        ResolveLoggerHandle(*handle);
+}
+
+bool Log::SetLoggerLevel(std::string const& loggerName, LogLevel level)
+{
+    if (level >= LogLevel::LOG_LEVEL_MAX || !Logger::has(loggerName))
+        return false;
+
+    Logger::get(loggerName).setLevel(static_cast<uint8>(level));
+
+    if (level > highestLogLevel)
+        highestLogLevel = level;
+
+    RefreshLoggerHandles();
+    return true;
+}
+
 std::string const Log::GetChannelsFromLogger(std::string const& loggerName)
 {
     std::string const& loggerOptions = sConfigMgr->GetOption<std::string>(PREFIX_LOGGER + loggerName, "6, Console Server");
@@ -205,11 +487,23 @@ void Log::CreateLoggerFromConfig(std::string const& configLoggerName)
 
     AutoPtr<SplitterChannel> splitterChannel(new SplitterChannel);
     auto const& channelsName = GetPositionOptions(options, LOGGER_OPTIONS_CHANNELS_NAME);
+    bool hasTextChannels = false;
 
     for (auto const& tokensFmtChannels : Warhead::Tokenize(channelsName, ' ', false))
     {
         std::string channelName{ tokensFmtChannels };
 
+        auto const& binaryItr = _binaryChannels.find(channelName);
+        if (binaryItr != _binaryChannels.end())
+        {
+            if (!_loggerBinaryChannels.emplace(loggerName, binaryItr->second.get()).second)
+                fmt::print("Log::CreateLoggerFromConfig - Logger ({}) can have only one binary channel, skip ({})\n", loggerName, channelName);
+
+            continue;
+        }
+
+        hasTextChannels = true;
+
         auto fmtChannel = GetFormattingChannel(channelName);
         if (!fmtChannel)
         {
@@ -220,6 +514,28 @@ void Log::CreateLoggerFromConfig(std::string const& configLoggerName)
         splitterChannel->addChannel(fmtChannel);
     }
 
+    _loggerTextChannels[loggerName] = hasTextChannels;
+
+    // "messages/seconds" per call site
+    auto rateLimit = GetPositionOptions(options, LOGGER_OPTIONS_RATE_LIMIT);
+    if (!rateLimit.empty())
+    {
+        auto const& rateTokens = Warhead::Tokenize(rateLimit, '/', false);
+        uint32 messages = 0;
+        uint32 seconds = 0;
+
+        if (rateTokens.size() == 2)
+        {
+            messages = Warhead::StringTo<uint32>(rateTokens[0]).value_or(0);
+            seconds = Warhead::StringTo<uint32>(rateTokens[1]).value_or(0);
+        }
+
+        if (messages && seconds)
+            _loggerRateLimits[loggerName] = { messages, seconds };
+        else
+            fmt::print("Log::CreateLoggerFromConfig: Wrong rate limit ({}) for logger {}, expected messages/seconds\n", rateLimit, loggerName);
+    }
+
     try
     {
         Logger::create(loggerName, splitterChannel, static_cast<uint8>(level));
@@ -258,12 +574,34 @@ void Log::CreateChannelsFromConfig(std::string const& logChannelName)
     }
 
     auto channelType = Warhead::StringTo<uint8>(GetPositionOptions(options, CHANNEL_OPTIONS_TYPE));
-    if (!channelType || (channelType && channelType > (uint8)FormattingChannelType::FORMATTING_CHANNEL_TYPE_FILE))
+    if (!channelType || (channelType && channelType > (uint8)FormattingChannelType::FORMATTING_CHANNEL_TYPE_DISCORD))
     {
         fmt::print("Log::CreateChannelsFromConfig: Wrong channel type for LogChannel.{}\n", channelName);
         return;
     }
 
+    // Binary channel has no pattern, text is rendered by the log decoder
+    if (channelType.value() == static_cast<uint8>(FormattingChannelType::FORMATTING_CHANNEL_TYPE_BINARY))
+    {
+        auto fileName = GetPositionOptions(options, CHANNEL_OPTIONS_OPTION_1);
+        if (fileName.empty())
+        {
+            fmt::print("Log::CreateChannelsFromConfig: Empty file name for binary LogChannel.{}\n", channelName);
+            return;
+        }
+
+        uint64 ringSize = Warhead::StringTo<uint32>(GetPositionOptions(options, CHANNEL_OPTIONS_OPTION_2)).value_or(64);
+
+        auto channel = std::make_unique<LogBinaryWriter>(m_logsDir + std::string(fileName), ringSize * 1024 * 1024);
+        if (!channel->Open())
+            return;
+
+        if (!_binaryChannels.emplace(channelName, std::move(channel)).second)
+            fmt::print("> Binary channel ({}) is already exist!\n", channelName);
+
+        return;
+    }
+
     auto times = GetPositionOptions(options, CHANNEL_OPTIONS_TIMES);
     if (times.empty())
     {
@@ -279,7 +617,7 @@ void Log::CreateChannelsFromConfig(std::string const& logChannelName)
     }
 
     // Start configuration pattern channel
-    AutoPtr<PatternFormatter> _pattern(new PatternFormatter);
+    AutoPtr<LogPatternFormatter> _pattern(new LogPatternFormatter);
 
     try
     {
@@ -342,9 +680,19 @@ void Log::CreateChannelsFromConfig(std::string const& logChannelName)
         auto flush = GetPositionOptions(options, CHANNEL_OPTIONS_OPTION_4);
         auto purgeAge = GetPositionOptions(options, CHANNEL_OPTIONS_OPTION_5);
         auto archive = GetPositionOptions(options, CHANNEL_OPTIONS_OPTION_6);
+        auto compress = GetPositionOptions(options, CHANNEL_OPTIONS_OPTION_7);
 
-        // Configuration file channel
-        AutoPtr<FileChannel> _fileChannel(new FileChannel);
+        // Configuration file channel, Poco::FileChannel only for rotation at a time of day
+        AutoPtr<Channel> _fileChannel;
+
+        if (LogFileChannel::IsSupportedRotation(rotation))
+        {
+            auto syncInterval = sConfigMgr->GetOption<uint32>("Log.File.SyncInterval", 1000);
+            auto syncSize = sConfigMgr->GetOption<uint32>("Log.File.SyncSize", 1024);
+            _fileChannel = new LogFileChannel(Milliseconds(syncInterval), uint64(syncSize) * 1024);
+        }
+        else
+            _fileChannel = new FileChannel;
 
         try
         {
@@ -365,6 +713,9 @@ void Log::CreateChannelsFromConfig(std::string const& logChannelName)
 
             if (!archive.empty())
                 _fileChannel->setProperty("archive", std::string(archive));
+
+            if (!compress.empty())
+                _fileChannel->setProperty("compress", std::string(compress));
         }
         catch (const std::exception& e)
         {
@@ -373,16 +724,57 @@ void Log::CreateChannelsFromConfig(std::string const& logChannelName)
 
         AddFormattingChannel(channelName, new FormattingChannel(_pattern, _fileChannel));
     }
+    else if (auto const& factoryItr = _channelFactories.find(channelType.value()); factoryItr != _channelFactories.end())
+    {
+        AutoPtr<Channel> _channel(factoryItr->second(channelName, std::vector<std::string_view>(tokens.begin() + CHANNEL_OPTIONS_PATTERN + 1, tokens.end())));
+        if (!_channel)
+            return;
+
+        AddFormattingChannel(channelName, new FormattingChannel(_pattern, _channel));
+    }
+    else if (channelType.value() == (uint8)FormattingChannelType::FORMATTING_CHANNEL_TYPE_DISCORD)
+        fmt::print("Log::CreateChannelsFromConfig: Discord channel type is not available, skip LogChannel.{}\n", channelName);
     else
         fmt::print("Log::CreateLoggerFromConfig: Invalid channel type ({})", channelType.value());
 }
 
 void Log::Write(std::string_view filter, LogLevel const level, std::string_view message)
 {
-    Logger* logger = GetLoggerByType(filter);
+    Write(GetLoggerHandle(filter), level, message);
+}
+
+void Log::Write(LogLoggerHandle const* handle, LogLevel const level, std::string_view message)
+{
+    Logger* logger = handle->Logger.load(std::memory_order_acquire);
     if (!logger)
         return;
 
+    // Async writer checks it on its own
+    if (!_asyncWriter)
+        WriteRateLimitSummaries();
+
+    if (_asyncWriter)
+    {
+        // Fatal is written in place after everything queued before it, the process is about to die
+        if (level != LogLevel::LOG_LEVEL_FATAL)
+        {
+            LogRecord record;
+            record.Logger = logger;
+            record.Level = level;
+            record.Time = Timestamp().epochMicroseconds();
+            record.NoForward = LogForwardGuard::IsActive();
+            record.SetText(message);
+
+            if (Thread* thread = Thread::current())
+                record.ThreadID = thread->id();
+
+            _asyncWriter->Push(std::move(record));
+            return;
+        }
+
+        _asyncWriter->Flush();
+    }
+
     try
     {
         switch (level)
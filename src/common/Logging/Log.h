@@ -19,8 +19,14 @@
 #define _LOG_H_
 
 #include "Define.h"
+#include "LogBinaryWriter.h"
 #include "StringFormat.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
+#include <vector>
 
 enum class LogLevel : uint8
 {
@@ -49,6 +55,7 @@ enum ChannelOptions
     CHANNEL_OPTIONS_OPTION_4,
     CHANNEL_OPTIONS_OPTION_5,
     CHANNEL_OPTIONS_OPTION_6,
+    CHANNEL_OPTIONS_OPTION_7,
 
     CHANNEL_OPTIONS_MAX
 };
@@ -56,7 +63,9 @@ enum ChannelOptions
 enum class FormattingChannelType : uint8
 {
     FORMATTING_CHANNEL_TYPE_CONSOLE = 1,
-    FORMATTING_CHANNEL_TYPE_FILE
+    FORMATTING_CHANNEL_TYPE_FILE,
+    FORMATTING_CHANNEL_TYPE_BINARY,
+    FORMATTING_CHANNEL_TYPE_DISCORD  // registered by the client, see Log::RegisterChannelType
 };
 
 // For create Logger
@@ -64,16 +73,75 @@ enum LoggerOptions
 {
     LOGGER_OPTIONS_LOG_LEVEL,
     LOGGER_OPTIONS_CHANNELS_NAME,
+    LOGGER_OPTIONS_RATE_LIMIT,
 
     LOGGER_OPTIONS_UNKNOWN
 };
 
 namespace Poco
 {
+    class Channel;
     class FormattingChannel;
     class Logger;
 }
 
+class LogAsyncWriter;
+
+// Filter interned once and resolved to the nearest configured logger ("network.opcode" -> "network" -> "root").
+// Handles are never freed, LOG_* call sites cache the pointer. Level and logger are updated in place on reload
+// and level change, LOG_LEVEL_DISABLED if no logger matches.
+struct LogLoggerHandle
+{
+    explicit LogLoggerHandle(std::string_view name) : Name(name) { }
+
+    std::string const Name;
+    std::atomic<LogLevel> Level{ LogLevel::LOG_LEVEL_DISABLED };
+    std::atomic<Poco::Logger*> Logger{ nullptr };
+    std::atomic<LogBinaryWriter*> Binary{ nullptr }; // binary channel of the logger
+    std::atomic<bool> Text{ false };                 // logger has text channels
+    std::atomic<uint32> RateLimit{ 0 };              // messages per call site and window, 0 - unlimited
+    std::atomic<uint32> RateWindow{ 0 };             // seconds
+};
+
+// Static data of one LOG_* call site, constant initialized
+struct LogCallSite
+{
+    constexpr LogCallSite(char const* format, char const* file, uint32 line) :
+        Format(format), File(file), Line(line) { }
+
+    char const* const Format;
+    char const* const File;
+    uint32 const Line;
+    std::atomic<LogLoggerHandle const*> Handle{ nullptr };
+    std::atomic<uint32> BinaryID{ 0 };
+
+    // Rate limit window, the count keeps growing while messages are suppressed
+    std::atomic<uint32> RateCount{ 0 };
+    std::atomic<int64> RateWindowStart{ 0 };
+    std::atomic<bool> RateSuppressed{ false }; // in the list checked by WriteRateLimitSummaries
+};
+
+// Records logged by the calling thread while alive are not forwarded by channels sending them over the network,
+// so the send path of such a channel can't feed itself. The mark follows records through the async writer
+class WH_COMMON_API LogForwardGuard
+{
+public:
+    explicit LogForwardGuard(bool active = true);
+    ~LogForwardGuard();
+
+    LogForwardGuard(LogForwardGuard const&) = delete;
+    LogForwardGuard& operator=(LogForwardGuard const&) = delete;
+
+    static bool IsActive();
+
+private:
+    bool _previous;
+};
+
+// Creates a channel of a type implemented outside of common, from the options after the pattern.
+// Returns nullptr on wrong options
+using LogChannelFactory = std::function<Poco::Channel*(std::string_view channelName, std::vector<std::string_view> const& options)>;
+
 class WH_COMMON_API Log
 {
 private:
@@ -90,23 +158,114 @@ public:
     void Initialize();
     void LoadFromConfig();
 
+    // Must be called before Initialize, channels of the type are skipped until registered
+    void RegisterChannelType(FormattingChannelType type, LogChannelFactory factory);
+
     bool ShouldLog(std::string_view type, LogLevel level) const;
 
+    // Single atomic load, used by LOG_* on every call
+    inline bool ShouldLog(LogLoggerHandle const* handle, LogLevel level) const
+    {
+        return level <= handle->Level.load(std::memory_order_relaxed);
+    }
+
+    // Rate limit of the logger for one call site, costs one atomic increment while under the limit
+    inline bool ShouldLog(LogCallSite& site, LogLoggerHandle const* handle, LogLevel level)
+    {
+        uint32 limit = handle->RateLimit.load(std::memory_order_relaxed);
+        if (!limit)
+            return true;
+
+        uint32 count = site.RateCount.fetch_add(1, std::memory_order_relaxed);
+        if (!count)
+            site.RateWindowStart.store(GetRateLimitTime(), std::memory_order_relaxed);
+
+        if (count < limit)
+            return true;
+
+        return RateLimitExceeded(site, handle, level);
+    }
+
+    // Reports suppressed messages of call sites whose window is over, so a site that stopped firing
+    // is reported too. Called by the async writer on each wake up, or by Write without it. Checks once per second
+    void WriteRateLimitSummaries();
+
+    LogLoggerHandle const* GetLoggerHandle(std::string_view filter);
+
+    // Per call site cache, a call site with a variable filter falls back to the interned lookup when it changes
+    inline LogLoggerHandle const* GetLoggerHandle(std::atomic<LogLoggerHandle const*>& cache, std::string_view filter)
+    {
+        LogLoggerHandle const* handle = cache.load(std::memory_order_acquire);
+        if (handle && handle->Name == filter)
+            return handle;
+
+        handle = GetLoggerHandle(filter);
+        cache.store(handle, std::memory_order_release);
+        return handle;
+    }
+
+    // Changes level of a configured logger at runtime, every filter resolved to it follows
+    bool SetLoggerLevel(std::string const& loggerName, LogLevel level);
+
     template<typename... Args>
     inline void outMessage(std::string const& filter, LogLevel const level, std::string_view fmt, Args&&... args)
     {
         Write(filter, level, fmt::format(fmt, std::forward<Args>(args)...));
     }
 
+    // Formats once into a reused thread local buffer, the format string is checked at compile time by LOG_*.
+    // Binary channels get the raw arguments, the text is formatted only if the logger has text channels.
+    template<typename Format, typename... Args>
+    inline void outMessage(LogCallSite& site, LogLoggerHandle const* handle, LogLevel const level, Format const& format, Args&&... args)
+    {
+        if (LogBinaryWriter* binary = handle->Binary.load(std::memory_order_acquire))
+            binary->Write(site, handle->Name, level, args...);
+
+        if (!handle->Text.load(std::memory_order_relaxed))
+            return;
+
+        FormatBuffer buffer;
+        fmt::format_to(std::back_inserter(buffer.Get()), format, std::forward<Args>(args)...);
+        Write(handle, level, std::string_view(buffer.Get().data(), buffer.Get().size()));
+    }
+
     void Write(std::string_view filter, LogLevel const level, std::string_view message);
+    void Write(LogLoggerHandle const* handle, LogLevel const level, std::string_view message);
+
+    // Waits until queued async records are written, called before fatal and assert exits
+    void Flush();
 
 private:
+    // Thread local buffer of the calling thread, or an own one for a LOG_* nested in argument formatting
+    class WH_COMMON_API FormatBuffer
+    {
+    public:
+        FormatBuffer();
+        ~FormatBuffer();
+
+        FormatBuffer(FormatBuffer const&) = delete;
+        FormatBuffer& operator=(FormatBuffer const&) = delete;
+
+        fmt::memory_buffer& Get() { return *_buffer; }
+
+    private:
+        fmt::memory_buffer* _buffer;
+        std::unique_ptr<fmt::memory_buffer> _nested;
+    };
+
     void CreateLoggerFromConfig(std::string const& configLoggerName);
     void CreateChannelsFromConfig(std::string const& logChannelName);
     void ReadLoggersFromConfig();
     void ReadChannelsFromConfig();
 
     void InitLogsDir();
+    void InitAsyncWriter();
+    void InitCompressor();
+    void RefreshLoggerHandles();
+    bool RateLimitExceeded(LogCallSite& site, LogLoggerHandle const* handle, LogLevel level);
+    void WriteRateLimitSummary(LogCallSite const& site, LogLoggerHandle const* handle, LogLevel level, uint32 suppressed, uint32 limit, uint32 window);
+    static int64 GetRateLimitTime();
+    void ResolveLoggerHandle(LogLoggerHandle& handle);
     void Clear();
 
     std::string_view GetPositionOptions(std::string_view options, uint8 position, std::string_view _default = {});
@@ -119,15 +278,46 @@ private:
     std::string m_logsDir;
     LogLevel highestLogLevel;
     std::unordered_map<std::string, Poco::FormattingChannel*> _channelStore;
+    std::unordered_map<uint8, LogChannelFactory> _channelFactories;
+    std::unique_ptr<LogAsyncWriter> _asyncWriter;
+
+    // Binary channels by channel name, and the one used by each logger
+    std::unordered_map<std::string, std::unique_ptr<LogBinaryWriter>> _binaryChannels;
+    std::unordered_map<std::string, LogBinaryWriter*> _loggerBinaryChannels;
+    std::unordered_map<std::string, bool> _loggerTextChannels;
+
+    // Rate limit by logger name: messages, seconds
+    std::unordered_map<std::string, std::pair<uint32, uint32>> _loggerRateLimits;
+
+    // Call sites with suppressed messages not reported yet
+    struct RateLimitedSite
+    {
+        LogCallSite* Site;
+        LogLoggerHandle const* Handle;
+        LogLevel Level;
+    };
+
+    std::mutex _rateLimitedSitesLock;
+    std::vector<RateLimitedSite> _rateLimitedSites;
+    std::atomic<int64> _nextRateLimitCheck{ 0 };
+
+    std::mutex _loggerHandlesLock;
+    std::unordered_map<std::string, std::unique_ptr<LogLoggerHandle>> _loggerHandles;
 };
 
 #define sLog Log::instance()
 
-#define LOG_EXCEPTION_FREE(filterType__, level__, ...) \
+// Highest log level compiled in, from the LOG_COMPILE_LEVEL cmake option.
+// LOG_* above it are discarded at compile time, arguments are not evaluated but still type checked.
+#ifndef WARHEAD_LOG_COMPILE_LEVEL
+#define WARHEAD_LOG_COMPILE_LEVEL 8
+#endif
+
+#define LOG_EXCEPTION_FREE(logSite__, logHandle__, level__, fmt__, ...) \
     { \
         try \
         { \
-            sLog->outMessage(filterType__, level__, fmt::format(__VA_ARGS__)); \
+            sLog->outMessage(logSite__, logHandle__, level__, FMT_STRING(fmt__), ##__VA_ARGS__); \
         } \
         catch (const std::exception& e) \
         { \
@@ -136,10 +326,15 @@ private:
         } \
     }
 
-#define LOG_MSG_BODY(filterType__, level__, ...)                        \
-        do {                                                            \
-            if (sLog->ShouldLog(filterType__, level__))                 \
-                LOG_EXCEPTION_FREE(filterType__, level__, __VA_ARGS__); \
+#define LOG_MSG_BODY(filterType__, level__, fmt__, ...)                                               \
+        do {                                                                                          \
+            if constexpr (static_cast<uint8>(level__) <= WARHEAD_LOG_COMPILE_LEVEL)                   \
+            {                                                                                         \
+                static LogCallSite logSite__{ fmt__, __FILE__, __LINE__ };                            \
+                LogLoggerHandle const* logHandle__ = sLog->GetLoggerHandle(logSite__.Handle, filterType__); \
+                if (sLog->ShouldLog(logHandle__, level__) && sLog->ShouldLog(logSite__, logHandle__, level__)) \
+                    LOG_EXCEPTION_FREE(logSite__, logHandle__, level__, fmt__, ##__VA_ARGS__);        \
+            }                                                                                         \
         } while (0)
 
 // Fatal - 1
@@ -0,0 +1,204 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "LogAsyncWriter.h"
+#include "Duration.h"
+#include "Log.h"
+#include <Poco/Logger.h>
+#include <Poco/Message.h>
+#include <Poco/Timestamp.h>
+#include <array>
+#include <fmt/core.h>
+
+LogAsyncWriter::LogAsyncWriter(std::size_t queueSize, LogOverflowPolicy policy) :
+    _queue(queueSize), _policy(policy)
+{
+    _thread = std::thread(&LogAsyncWriter::WriterThread, this);
+}
+
+LogAsyncWriter::~LogAsyncWriter()
+{
+    Stop();
+}
+
+void LogAsyncWriter::Stop()
+{
+    {
+        std::lock_guard<std::mutex> guard(_mutex);
+        _stop = true;
+    }
+
+    _writerCondition.notify_one();
+
+    if (_thread.joinable())
+        _thread.join();
+}
+
+bool LogAsyncWriter::Push(LogRecord&& record)
+{
+    while (!_queue.Enqueue(std::move(record)))
+    {
+        // Writer thread can't wait for itself, and a stopping writer may never come back
+        if (_policy != LogOverflowPolicy::LOG_OVERFLOW_POLICY_BLOCK || IsWriterThread() || _stop)
+        {
+            ++_droppedTotal;
+
+            if (_policy == LogOverflowPolicy::LOG_OVERFLOW_POLICY_DROP_AND_COUNT)
+            {
+                _droppedLogger.store(record.Logger, std::memory_order_relaxed);
+                ++_dropped;
+            }
+
+            return false;
+        }
+
+        WakeWriter();
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        ++_waiters;
+        _doneCondition.wait_for(lock, 1ms);
+        --_waiters;
+    }
+
+    ++_pushed;
+
+    // Pairs with the fence in WriterThread: either the writer sees the record or we see it sleeping
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_writerSleeping.load(std::memory_order_relaxed))
+        WakeWriter();
+
+    return true;
+}
+
+void LogAsyncWriter::Flush()
+{
+    if (IsWriterThread())
+        return;
+
+    uint64 target = _pushed.load();
+    if (_written.load() >= target)
+        return;
+
+    WakeWriter();
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    ++_waiters;
+    _doneCondition.wait(lock, [this, target]() { return _written.load() >= target; });
+    --_waiters;
+}
+
+void LogAsyncWriter::WakeWriter()
+{
+    std::lock_guard<std::mutex> guard(_mutex);
+    _writerCondition.notify_one();
+}
+
+void LogAsyncWriter::NotifyWaiters()
+{
+    if (!_waiters.load())
+        return;
+
+    std::lock_guard<std::mutex> guard(_mutex);
+    _doneCondition.notify_all();
+}
+
+void LogAsyncWriter::ReportDropped()
+{
+    uint64 dropped = _dropped.exchange(0);
+    if (!dropped)
+        return;
+
+    Poco::Logger* logger = _droppedLogger.load(std::memory_order_relaxed);
+    if (!logger)
+        return;
+
+    try
+    {
+        logger->error(fmt::format("Log: async queue is full, {} messages dropped", dropped));
+    }
+    catch (const std::exception& e)
+    {
+        fmt::print("LogAsyncWriter::ReportDropped - '{}'", e.what());
+    }
+}
+
+void LogAsyncWriter::WriteRecord(LogRecord& record)
+{
+    try
+    {
+        Poco::Message message(record.Logger->name(), std::string(record.GetText()), static_cast<Poco::Message::Priority>(record.Level));
+        message.setTime(Poco::Timestamp(record.Time));
+        message.setTid(record.ThreadID);
+
+        LogForwardGuard forwardGuard(record.NoForward);
+        record.Logger->log(message);
+    }
+    catch (const std::exception& e)
+    {
+        fmt::print("LogAsyncWriter::WriteRecord - '{}'", e.what());
+    }
+}
+
+void LogAsyncWriter::WriterThread()
+{
+    std::array<LogRecord, BatchSize> batch;
+
+    for (;;)
+    {
+        std::size_t count = _queue.DequeueBulk(batch.data(), batch.size());
+
+        for (std::size_t i = 0; i < count; ++i)
+            WriteRecord(batch[i]);
+
+        // Summaries of rate limited call sites that went quiet, pushed back to this queue
+        sLog->WriteRateLimitSummaries();
+
+        if (count)
+        {
+            _written += count;
+            NotifyWaiters();
+            continue;
+        }
+
+        ReportDropped();
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (_stop)
+            break;
+
+        _writerSleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        // Timeout is only a safety net, producers wake the writer when it sleeps
+        if (_queue.IsEmpty())
+            _writerCondition.wait_for(lock, 100ms);
+
+        _writerSleeping.store(false, std::memory_order_relaxed);
+    }
+
+    // Late records pushed while stopping
+    std::size_t count;
+    while ((count = _queue.DequeueBulk(batch.data(), batch.size())))
+    {
+        for (std::size_t i = 0; i < count; ++i)
+            WriteRecord(batch[i]);
+
+        _written += count;
+    }
+
+    NotifyWaiters();
+}
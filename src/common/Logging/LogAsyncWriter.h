@@ -0,0 +1,135 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LOG_ASYNC_WRITER_H_
+#define _LOG_ASYNC_WRITER_H_
+
+#include "Define.h"
+#include "MPMCQueue.h"
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+enum class LogLevel : uint8;
+
+namespace Poco
+{
+    class Logger;
+}
+
+enum class LogOverflowPolicy : uint8
+{
+    LOG_OVERFLOW_POLICY_BLOCK,          // wait for the writer thread
+    LOG_OVERFLOW_POLICY_DROP,           // drop silently
+    LOG_OVERFLOW_POLICY_DROP_AND_COUNT, // drop and write how many records were lost
+
+    LOG_OVERFLOW_POLICY_MAX
+};
+
+// Formatted message waiting in the async queue, time and thread are captured by the caller.
+// Short texts are stored inline in the queue cell, so queueing them does not allocate.
+struct LogRecord
+{
+    static constexpr std::size_t InlineTextSize = 216;
+
+    void SetText(std::string_view text)
+    {
+        if (text.size() <= InlineTextSize)
+        {
+            std::memcpy(InlineText.data(), text.data(), text.size());
+            InlineTextLength = static_cast<uint8>(text.size());
+            LongText.clear();
+        }
+        else
+        {
+            InlineTextLength = 0;
+            LongText.assign(text);
+        }
+    }
+
+    std::string_view GetText() const
+    {
+        return LongText.empty() ? std::string_view(InlineText.data(), InlineTextLength) : std::string_view(LongText);
+    }
+
+    Poco::Logger* Logger{ nullptr };
+    LogLevel Level{};
+    int64 Time{ 0 }; // Poco::Timestamp epoch microseconds
+    long ThreadID{ 0 };
+    bool NoForward{ false }; // logged under LogForwardGuard
+    uint8 InlineTextLength{ 0 };
+    std::array<char, InlineTextSize> InlineText;
+    std::string LongText;
+};
+
+// Bounded lock free record queue drained by one writer thread into the Poco loggers,
+// so the caller never waits for the formatter, console or disk
+class WH_COMMON_API LogAsyncWriter
+{
+public:
+    LogAsyncWriter(std::size_t queueSize, LogOverflowPolicy policy);
+    ~LogAsyncWriter();
+
+    LogAsyncWriter(LogAsyncWriter const&) = delete;
+    LogAsyncWriter& operator=(LogAsyncWriter const&) = delete;
+
+    // Any thread. Returns false if the record was dropped by the overflow policy
+    bool Push(LogRecord&& record);
+
+    // Blocks until every record pushed before the call is written. Does nothing on the writer thread
+    void Flush();
+
+    // Writes the queued records and joins the writer thread, which may still log through Log until then
+    void Stop();
+
+    bool IsWriterThread() const { return std::this_thread::get_id() == _thread.get_id(); }
+    uint64 GetDroppedCount() const { return _droppedTotal.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr std::size_t BatchSize = 64;
+
+    void WriterThread();
+    void WriteRecord(LogRecord& record);
+    void WakeWriter();
+    void NotifyWaiters();
+    void ReportDropped();
+
+    Warhead::Impl::MPMCQueueBounded<LogRecord> _queue;
+    LogOverflowPolicy _policy;
+
+    std::mutex _mutex;
+    std::condition_variable _writerCondition; // writer waits for records
+    std::condition_variable _doneCondition;   // blocked producers and Flush wait for the writer
+    std::atomic<bool> _writerSleeping{ false };
+    std::atomic<uint32> _waiters{ 0 };
+    std::atomic<bool> _stop{ false };
+
+    std::atomic<uint64> _pushed{ 0 };
+    std::atomic<uint64> _written{ 0 };
+    std::atomic<uint64> _dropped{ 0 };
+    std::atomic<uint64> _droppedTotal{ 0 };
+    std::atomic<Poco::Logger*> _droppedLogger{ nullptr };
+
+    std::thread _thread;
+};
+
+#endif // _LOG_ASYNC_WRITER_H_
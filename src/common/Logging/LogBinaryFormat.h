@@ -0,0 +1,89 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LOG_BINARY_FORMAT_H_
+#define _LOG_BINARY_FORMAT_H_
+
+#include "Define.h"
+
+/*
+ * Layout of the binary log file, shared by LogBinaryWriter and the log decoder tool.
+ *
+ * [LogBinaryFileHeader][site table][record ring]
+ *
+ * Site table is append only: one LogBinarySiteHeader per call site followed by file, filter and format text.
+ * Ring holds records from Tail to Head (Used bytes): LogBinaryRecordHeader followed by the arguments, each one
+ * is a LogBinaryArgType byte and the value (strings: uint32 length and the bytes). Records are 8 byte aligned
+ * with zero bytes, a record with SiteID 0 pads the ring up to its end.
+ */
+
+constexpr char LOG_BINARY_MAGIC[8] = { 'W', 'H', 'B', 'L', 'O', 'G', '\0', '\1' };
+constexpr uint32 LOG_BINARY_VERSION = 1;
+constexpr uint32 LOG_BINARY_PAD_SITE = 0;
+constexpr uint32 LOG_BINARY_ALIGN = 8;
+
+enum class LogBinaryArgType : uint8
+{
+    LOG_BINARY_ARG_INT = 1,
+    LOG_BINARY_ARG_UINT,
+    LOG_BINARY_ARG_DOUBLE,
+    LOG_BINARY_ARG_BOOL,
+    LOG_BINARY_ARG_CHAR,
+    LOG_BINARY_ARG_STRING,
+    LOG_BINARY_ARG_POINTER
+};
+
+#pragma pack(push, 1)
+
+struct LogBinaryFileHeader
+{
+    char Magic[8];
+    uint32 Version;
+    uint32 HeaderSize;
+    uint64 SiteTableOffset;
+    uint64 SiteTableSize;
+    uint64 SiteTableUsed;
+    uint64 RingOffset;
+    uint64 RingSize;
+    uint64 Head;
+    uint64 Tail;
+    uint64 Used;
+    uint64 Records;
+    uint64 Dropped;
+};
+
+struct LogBinarySiteHeader
+{
+    uint32 Size; // with the texts
+    uint32 SiteID;
+    uint8 Level;
+    uint32 Line;
+    uint16 FileLength;
+    uint16 FilterLength;
+    uint16 FormatLength;
+};
+
+struct LogBinaryRecordHeader
+{
+    uint32 Size; // with the arguments and alignment
+    uint32 SiteID;
+    int64 Time;  // nanoseconds since epoch, system clock
+};
+
+#pragma pack(pop)
+
+#endif // _LOG_BINARY_FORMAT_H_
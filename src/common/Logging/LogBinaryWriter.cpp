@@ -0,0 +1,224 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "LogBinaryWriter.h"
+#include "Log.h"
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+    // Call site ids are shared by all binary channels, every file gets the site on first use
+    std::atomic<uint32> NextSiteID{ 1 };
+
+    uint32 GetSiteID(LogCallSite& site)
+    {
+        uint32 siteID = site.BinaryID.load(std::memory_order_acquire);
+        if (siteID)
+            return siteID;
+
+        uint32 newID = NextSiteID.fetch_add(1);
+        if (site.BinaryID.compare_exchange_strong(siteID, newID, std::memory_order_acq_rel))
+            return newID;
+
+        return siteID;
+    }
+
+    constexpr uint64 Align(uint64 size)
+    {
+        return (size + LOG_BINARY_ALIGN - 1) & ~uint64(LOG_BINARY_ALIGN - 1);
+    }
+}
+
+LogBinaryWriter::LogBinaryWriter(std::string path, uint64 ringSize) :
+    _path(std::move(path)), _ringSize(Align(std::max<uint64>(ringSize, 64 * 1024))) { }
+
+LogBinaryWriter::~LogBinaryWriter()
+{
+    Flush();
+}
+
+bool LogBinaryWriter::Open()
+{
+    uint64 const headerSize = Align(sizeof(LogBinaryFileHeader));
+    uint64 const fileSize = headerSize + SiteTableSize + _ringSize;
+
+    try
+    {
+        // The file of the previous run is what a crash left behind, it is kept as <file>.1
+        std::error_code error;
+        if (std::filesystem::exists(_path, error))
+            std::filesystem::rename(_path, _path + ".1", error);
+
+        if (error)
+            fmt::print("LogBinaryWriter::Open: Can't keep previous file '{}' - {}\n", _path, error.message());
+
+        // Always a new file, records of the previous run are not mixed with site ids of this one
+        std::ofstream(_path, std::ios::binary | std::ios::trunc).close();
+        std::filesystem::resize_file(_path, fileSize);
+
+        boost::interprocess::file_mapping file(_path.c_str(), boost::interprocess::read_write);
+        _region = std::make_unique<boost::interprocess::mapped_region>(file, boost::interprocess::read_write, 0, fileSize);
+    }
+    catch (std::exception const& e)
+    {
+        fmt::print("LogBinaryWriter::Open: Can't map file '{}' - {}\n", _path, e.what());
+        _region.reset();
+        return false;
+    }
+
+    LogBinaryFileHeader header{};
+    std::memcpy(header.Magic, LOG_BINARY_MAGIC, sizeof(header.Magic));
+    header.Version = LOG_BINARY_VERSION;
+    header.HeaderSize = static_cast<uint32>(headerSize);
+    header.SiteTableOffset = headerSize;
+    header.SiteTableSize = SiteTableSize;
+    header.RingOffset = headerSize + SiteTableSize;
+    header.RingSize = _ringSize;
+    std::memcpy(GetHeader(), &header, sizeof(header));
+    return true;
+}
+
+void LogBinaryWriter::Flush()
+{
+    if (_region)
+        _region->flush(0, 0, true);
+}
+
+LogBinaryFileHeader* LogBinaryWriter::GetHeader() const
+{
+    return static_cast<LogBinaryFileHeader*>(_region->get_address());
+}
+
+char* LogBinaryWriter::GetRing() const
+{
+    return static_cast<char*>(_region->get_address()) + GetHeader()->RingOffset;
+}
+
+void LogBinaryWriter::Append(LogCallSite& site, std::string_view filter, LogLevel level, char const* data, std::size_t size)
+{
+    if (!_region)
+        return;
+
+    int64 time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    uint32 siteID = GetSiteID(site);
+    uint64 recordSize = Align(sizeof(LogBinaryRecordHeader) + size);
+
+    std::lock_guard<std::mutex> guard(_lock);
+
+    LogBinaryFileHeader* header = GetHeader();
+
+    // Never let one record take over the ring
+    if (recordSize > _ringSize / 4)
+    {
+        ++header->Dropped;
+        return;
+    }
+
+    if (siteID >= _writtenSites.size())
+        _writtenSites.resize(siteID + 64);
+
+    if (!_writtenSites[siteID])
+    {
+        WriteSite(site, siteID, filter, level);
+        _writtenSites[siteID] = true;
+    }
+
+    char* ring = GetRing();
+
+    // Not enough room up to the end, pad it and continue from the start
+    if (header->Head + recordSize > _ringSize)
+    {
+        uint64 rest = _ringSize - header->Head;
+        Evict(header->Head, rest);
+
+        LogBinaryRecordHeader pad{ static_cast<uint32>(rest), LOG_BINARY_PAD_SITE, 0 };
+        std::memcpy(ring + header->Head, &pad, std::min<uint64>(rest, sizeof(pad)));
+
+        header->Used += rest;
+        header->Head = 0;
+    }
+
+    Evict(header->Head, recordSize);
+
+    LogBinaryRecordHeader record{ static_cast<uint32>(recordSize), siteID, time };
+    std::memcpy(ring + header->Head, &record, sizeof(record));
+    std::memcpy(ring + header->Head + sizeof(record), data, size);
+    std::memset(ring + header->Head + sizeof(record) + size, 0, recordSize - sizeof(record) - size);
+
+    header->Head += recordSize;
+    if (header->Head == _ringSize)
+        header->Head = 0;
+
+    header->Used += recordSize;
+    ++header->Records;
+}
+
+void LogBinaryWriter::Evict(uint64 offset, uint64 length)
+{
+    LogBinaryFileHeader* header = GetHeader();
+    char const* ring = GetRing();
+
+    while (header->Used && header->Tail >= offset && header->Tail < offset + length)
+    {
+        uint32 size;
+        std::memcpy(&size, ring + header->Tail, sizeof(size));
+
+        header->Tail += size;
+        if (header->Tail >= _ringSize)
+            header->Tail = 0;
+
+        header->Used -= size;
+    }
+}
+
+void LogBinaryWriter::WriteSite(LogCallSite const& site, uint32 siteID, std::string_view filter, LogLevel level)
+{
+    LogBinaryFileHeader* header = GetHeader();
+
+    std::string_view file(site.File);
+    std::string_view format(site.Format);
+
+    LogBinarySiteHeader siteHeader{};
+    siteHeader.Size = static_cast<uint32>(sizeof(siteHeader) + file.size() + filter.size() + format.size());
+    siteHeader.SiteID = siteID;
+    siteHeader.Level = static_cast<uint8>(level);
+    siteHeader.Line = site.Line;
+    siteHeader.FileLength = static_cast<uint16>(file.size());
+    siteHeader.FilterLength = static_cast<uint16>(filter.size());
+    siteHeader.FormatLength = static_cast<uint16>(format.size());
+
+    // Records of a site missing from a full table are shown by the decoder as unknown
+    if (header->SiteTableUsed + siteHeader.Size > header->SiteTableSize)
+        return;
+
+    char* out = static_cast<char*>(_region->get_address()) + header->SiteTableOffset + header->SiteTableUsed;
+    std::memcpy(out, &siteHeader, sizeof(siteHeader));
+    out += sizeof(siteHeader);
+    std::memcpy(out, file.data(), file.size());
+    out += file.size();
+    std::memcpy(out, filter.data(), filter.size());
+    out += filter.size();
+    std::memcpy(out, format.data(), format.size());
+
+    header->SiteTableUsed += siteHeader.Size;
+}
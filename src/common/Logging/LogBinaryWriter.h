@@ -0,0 +1,131 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LOG_BINARY_WRITER_H_
+#define _LOG_BINARY_WRITER_H_
+
+#include "Define.h"
+#include "LogBinaryFormat.h"
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include <fmt/format.h>
+
+enum class LogLevel : uint8;
+struct LogCallSite;
+
+namespace boost::interprocess
+{
+    class mapped_region;
+}
+
+namespace Warhead::Impl
+{
+    using LogBinaryBuffer = fmt::memory_buffer;
+
+    template<typename T>
+    inline void LogBinaryPutValue(LogBinaryBuffer& buffer, LogBinaryArgType type, T value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+
+        char bytes[sizeof(T) + 1];
+        bytes[0] = static_cast<char>(type);
+        std::memcpy(bytes + 1, &value, sizeof(T));
+        buffer.append(bytes, bytes + sizeof(bytes));
+    }
+
+    inline void LogBinaryPutString(LogBinaryBuffer& buffer, std::string_view value)
+    {
+        LogBinaryPutValue(buffer, LogBinaryArgType::LOG_BINARY_ARG_STRING, static_cast<uint32>(value.size()));
+        buffer.append(value.data(), value.data() + value.size());
+    }
+
+    // Raw value for the types the decoder can rebuild, text formatted with "{}" for everything else
+    template<typename T>
+    inline void LogBinaryPut(LogBinaryBuffer& buffer, T const& arg)
+    {
+        using Type = std::decay_t<T>;
+
+        if constexpr (std::is_same_v<Type, bool>)
+            LogBinaryPutValue(buffer, LogBinaryArgType::LOG_BINARY_ARG_BOOL, static_cast<uint8>(arg));
+        else if constexpr (std::is_same_v<Type, char>)
+            LogBinaryPutValue(buffer, LogBinaryArgType::LOG_BINARY_ARG_CHAR, arg);
+        else if constexpr (std::is_integral_v<Type> && std::is_signed_v<Type>)
+            LogBinaryPutValue(buffer, LogBinaryArgType::LOG_BINARY_ARG_INT, static_cast<int64>(arg));
+        else if constexpr (std::is_integral_v<Type>)
+            LogBinaryPutValue(buffer, LogBinaryArgType::LOG_BINARY_ARG_UINT, static_cast<uint64>(arg));
+        else if constexpr (std::is_enum_v<Type> && !fmt::has_formatter<Type, fmt::format_context>::value)
+            LogBinaryPut(buffer, static_cast<std::underlying_type_t<Type>>(arg));
+        else if constexpr (std::is_floating_point_v<Type>)
+            LogBinaryPutValue(buffer, LogBinaryArgType::LOG_BINARY_ARG_DOUBLE, static_cast<double>(arg));
+        else if constexpr (std::is_convertible_v<T const&, std::string_view>)
+            LogBinaryPutString(buffer, std::string_view(arg));
+        else if constexpr (std::is_pointer_v<Type>)
+            LogBinaryPutValue(buffer, LogBinaryArgType::LOG_BINARY_ARG_POINTER, static_cast<uint64>(reinterpret_cast<uintptr_t>(arg)));
+        else
+            LogBinaryPutString(buffer, fmt::format("{}", arg));
+    }
+}
+
+// Binary log channel: records call site id, time and raw arguments into a memory mapped ring file,
+// text is rendered offline by the log decoder tool. Oldest records are overwritten when the ring is full.
+class WH_COMMON_API LogBinaryWriter
+{
+public:
+    LogBinaryWriter(std::string path, uint64 ringSize);
+    ~LogBinaryWriter();
+
+    LogBinaryWriter(LogBinaryWriter const&) = delete;
+    LogBinaryWriter& operator=(LogBinaryWriter const&) = delete;
+
+    // Creates and maps the file, prints the error and returns false on failure
+    bool Open();
+
+    template<typename... Args>
+    void Write(LogCallSite& site, std::string_view filter, LogLevel level, Args const&... args)
+    {
+        Warhead::Impl::LogBinaryBuffer buffer;
+        (Warhead::Impl::LogBinaryPut(buffer, args), ...);
+        Append(site, filter, level, buffer.data(), buffer.size());
+    }
+
+    // Asks the OS to write dirty pages, the data is already visible in the file for a crashed process
+    void Flush();
+
+    std::string const& GetPath() const { return _path; }
+
+    static constexpr uint64 SiteTableSize = 1024 * 1024;
+
+private:
+    void Append(LogCallSite& site, std::string_view filter, LogLevel level, char const* data, std::size_t size);
+    void WriteSite(LogCallSite const& site, uint32 siteID, std::string_view filter, LogLevel level);
+    void Evict(uint64 offset, uint64 length);
+    LogBinaryFileHeader* GetHeader() const;
+    char* GetRing() const;
+
+    std::string _path;
+    uint64 _ringSize;
+    std::unique_ptr<boost::interprocess::mapped_region> _region;
+    std::vector<bool> _writtenSites;
+    std::mutex _lock;
+};
+
+#endif // _LOG_BINARY_WRITER_H_
@@ -0,0 +1,248 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "LogCompressor.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <fmt/format.h>
+#include <zlib.h>
+
+#if WARHEAD_PLATFORM == WARHEAD_PLATFORM_WINDOWS
+#include <windows.h>
+#elif defined(__linux__)
+#include <cerrno>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    constexpr std::size_t CompressBufferSize = 64 * 1024;
+
+    // Lowers the priority of the calling pool thread for one job, the destructor restores it.
+    // Linux lets a thread lower its nice value back only with CAP_SYS_NICE or a high enough RLIMIT_NICE,
+    // without that the job keeps the normal priority so the pool thread is not slowed down for good
+    class ThreadNiceGuard
+    {
+    public:
+        explicit ThreadNiceGuard(int32 nice)
+        {
+            if (nice <= 0)
+                return;
+
+#if WARHEAD_PLATFORM == WARHEAD_PLATFORM_WINDOWS
+            _previous = GetThreadPriority(GetCurrentThread());
+            _changed = SetThreadPriority(GetCurrentThread(), nice >= 10 ? THREAD_PRIORITY_LOWEST : THREAD_PRIORITY_BELOW_NORMAL);
+#elif defined(__linux__)
+            id_t const thread = static_cast<id_t>(syscall(SYS_gettid));
+
+            errno = 0;
+            int const previous = getpriority(PRIO_PROCESS, thread);
+            if (errno)
+                return;
+
+            if (!CanRestore(previous))
+            {
+                static std::once_flag warned;
+                std::call_once(warned, [nice]()
+                {
+                    fmt::print("LogCompressor: Nice level {} needs CAP_SYS_NICE or RLIMIT_NICE to restore the pool thread priority, compressing at normal priority\n", nice);
+                });
+
+                return;
+            }
+
+            _previous = previous;
+            _changed = !setpriority(PRIO_PROCESS, thread, std::min(previous + nice, 19));
+#endif
+        }
+
+        ~ThreadNiceGuard()
+        {
+            if (!_changed)
+                return;
+
+#if WARHEAD_PLATFORM == WARHEAD_PLATFORM_WINDOWS
+            SetThreadPriority(GetCurrentThread(), _previous);
+#elif defined(__linux__)
+            if (setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), _previous))
+                fmt::print("LogCompressor: Can't restore nice level {} of the pool thread\n", _previous);
+#endif
+        }
+
+        ThreadNiceGuard(ThreadNiceGuard const&) = delete;
+        ThreadNiceGuard& operator=(ThreadNiceGuard const&) = delete;
+
+    private:
+#if defined(__linux__)
+        static bool CanRestore(int previous)
+        {
+            if (!geteuid())
+                return true;
+
+            // Lowest nice value reachable without privileges is 20 - RLIMIT_NICE
+            rlimit limit;
+            if (getrlimit(RLIMIT_NICE, &limit))
+                return false;
+
+            return limit.rlim_cur == RLIM_INFINITY || 20 - static_cast<int>(limit.rlim_cur) <= previous;
+        }
+#endif
+
+        int _previous{ 0 };
+        bool _changed{ false };
+    };
+}
+
+LogCompressor::~LogCompressor()
+{
+    // Pending files are compressed before exit, their channels wait for them
+    std::unique_lock<std::mutex> lock(_lock);
+    _condition.wait(lock, [this] { return !_runningJobs; });
+}
+
+LogCompressor* LogCompressor::instance()
+{
+    static LogCompressor instance;
+    return &instance;
+}
+
+void LogCompressor::Configure(uint32 threads, int32 nice, int32 level)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _threadCount = std::max<uint32>(threads, 1);
+    _nice = nice;
+    _level = std::clamp<int32>(level, Z_BEST_SPEED, Z_BEST_COMPRESSION);
+}
+
+void LogCompressor::Compress(std::string path, Callback callback)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _jobs.push_back({ std::move(path), std::move(callback) });
+
+    // Running jobs take the queued files in turn, one more only below the cap
+    if (_runningJobs >= _threadCount)
+        return;
+
+    ++_runningJobs;
+    sThreadPool->Submit([this]() { RunJobs(); });
+}
+
+void LogCompressor::RunJobs()
+{
+    std::unique_lock<std::mutex> lock(_lock);
+
+    while (!_jobs.empty())
+    {
+        Job job = std::move(_jobs.front());
+        _jobs.pop_front();
+
+        int32 const nice = _nice;
+        int32 const level = _level;
+
+        lock.unlock();
+
+        bool result;
+
+        {
+            ThreadNiceGuard niceGuard(nice);
+            result = CompressFile(job.Path, level);
+        }
+
+        if (job.Done)
+            job.Done(result);
+
+        lock.lock();
+    }
+
+    --_runningJobs;
+    _condition.notify_all();
+}
+
+bool LogCompressor::CompressFile(std::string const& path, int32 level) const
+{
+    std::string const target = path + ".gz";
+
+    std::ifstream in(path, std::ios::binary);
+    std::ofstream out(target, std::ios::binary | std::ios::trunc);
+    if (!in || !out)
+    {
+        fmt::print("LogCompressor: Can't open '{}' or '{}'\n", path, target);
+        return false;
+    }
+
+    z_stream stream{};
+
+    // Window bits 15 + 16 writes a gzip header, readable by gzip and zcat
+    if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        fmt::print("LogCompressor: deflateInit2 failed for '{}'\n", path);
+        return false;
+    }
+
+    std::array<char, CompressBufferSize> input;
+    std::array<char, CompressBufferSize> output;
+    int result = Z_OK;
+
+    do
+    {
+        in.read(input.data(), input.size());
+        stream.next_in = reinterpret_cast<Bytef*>(input.data());
+        stream.avail_in = static_cast<uInt>(in.gcount());
+
+        int flush = in.eof() ? Z_FINISH : Z_NO_FLUSH;
+
+        do
+        {
+            stream.next_out = reinterpret_cast<Bytef*>(output.data());
+            stream.avail_out = static_cast<uInt>(output.size());
+
+            result = deflate(&stream, flush);
+            out.write(output.data(), output.size() - stream.avail_out);
+        } while (stream.avail_out == 0 && out);
+
+        if (flush == Z_FINISH)
+            break;
+    } while (in && out);
+
+    deflateEnd(&stream);
+    out.close();
+
+    if (result != Z_STREAM_END || !out)
+    {
+        fmt::print("LogCompressor: Can't compress '{}'\n", path);
+
+        std::error_code error;
+        fs::remove(target, error);
+        return false;
+    }
+
+    // Purge age counts from the last write of the log, not from the compression
+    std::error_code error;
+    auto writeTime = fs::last_write_time(path, error);
+    if (!error)
+        fs::last_write_time(target, writeTime, error);
+
+    fs::remove(path, error);
+    return true;
+}
@@ -0,0 +1,72 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LOG_COMPRESSOR_H_
+#define _LOG_COMPRESSOR_H_
+
+#include "Define.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+
+// Gzip compression of rotated log files, shared by all file channels.
+// Files are compressed by jobs on the shared ThreadPool, the thread count bounds how many run at once.
+// A job may lower the CPU priority of its pool thread, it is restored afterwards.
+class WH_COMMON_API LogCompressor
+{
+public:
+    using Callback = std::function<void(bool)>;
+
+    static LogCompressor* instance();
+
+    // Applies to jobs started after the call
+    void Configure(uint32 threads, int32 nice, int32 level);
+
+    // Compresses path into path.gz with the same modification time and removes path.
+    // Callback gets the result on the pool thread
+    void Compress(std::string path, Callback callback);
+
+private:
+    LogCompressor() = default;
+    ~LogCompressor();
+
+    LogCompressor(LogCompressor const&) = delete;
+    LogCompressor& operator=(LogCompressor const&) = delete;
+
+    struct Job
+    {
+        std::string Path;
+        Callback Done;
+    };
+
+    void RunJobs();
+    bool CompressFile(std::string const& path, int32 level) const;
+
+    std::mutex _lock;
+    std::condition_variable _condition; // destructor waits for the running pool jobs
+    std::deque<Job> _jobs;
+    uint32 _threadCount{ 1 };
+    uint32 _runningJobs{ 0 };
+    int32 _nice{ 0 };
+    int32 _level{ 6 };
+};
+
+#define sLogCompressor LogCompressor::instance()
+
+#endif // _LOG_COMPRESSOR_H_
@@ -0,0 +1,852 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "LogFileChannel.h"
+#include "LogCompressor.h"
+#include "StringConvert.h"
+#include "ThreadPool.h"
+#include <Poco/Exception.h>
+#include <Poco/Message.h>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <system_error>
+#include <fmt/chrono.h>
+#include <fmt/format.h>
+
+#if WARHEAD_PLATFORM == WARHEAD_PLATFORM_WINDOWS
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    constexpr auto ROTATING_SUFFIX = ".rotating";
+
+    std::string_view TrimSpaces(std::string_view value)
+    {
+        while (!value.empty() && std::isspace(static_cast<unsigned char>(value.front())))
+            value.remove_prefix(1);
+
+        while (!value.empty() && std::isspace(static_cast<unsigned char>(value.back())))
+            value.remove_suffix(1);
+
+        return value;
+    }
+
+    // "<n> [unit]"
+    bool SplitNumber(std::string_view value, uint64& number, std::string_view& unit)
+    {
+        value = TrimSpaces(value);
+
+        std::size_t digits = 0;
+        while (digits < value.size() && std::isdigit(static_cast<unsigned char>(value[digits])))
+            ++digits;
+
+        auto result = Warhead::StringTo<uint64>(value.substr(0, digits));
+        if (!digits || !result)
+            return false;
+
+        number = *result;
+        unit = TrimSpaces(value.substr(digits));
+        return true;
+    }
+
+    std::optional<Seconds> GetUnitDuration(std::string_view unit)
+    {
+        if (unit == "seconds")
+            return Seconds(1);
+        if (unit == "minutes")
+            return Seconds(60);
+        if (unit == "hours")
+            return Seconds(3600);
+        if (unit == "days")
+            return Seconds(86400);
+        if (unit == "weeks")
+            return Seconds(7 * 86400);
+        if (unit == "months")
+            return Seconds(30 * 86400);
+
+        return {};
+    }
+
+    // Poco::FileChannel rotation syntax, without the time of day forms
+    bool ParseRotation(std::string_view rotation, uint64& size, Seconds& interval)
+    {
+        size = 0;
+        interval = Seconds(0);
+        rotation = TrimSpaces(rotation);
+
+        if (rotation.empty() || rotation == "never")
+            return true;
+
+        if (rotation == "daily")
+        {
+            interval = Seconds(86400);
+            return true;
+        }
+
+        if (rotation == "weekly")
+        {
+            interval = Seconds(7 * 86400);
+            return true;
+        }
+
+        if (rotation == "monthly")
+        {
+            interval = Seconds(30 * 86400);
+            return true;
+        }
+
+        uint64 number;
+        std::string_view unit;
+        if (!SplitNumber(rotation, number, unit) || !number)
+            return false;
+
+        if (unit.empty())
+            size = number;
+        else if (unit == "K")
+            size = number * 1024;
+        else if (unit == "M")
+            size = number * 1024 * 1024;
+        else if (auto duration = GetUnitDuration(unit))
+            interval = *duration * number;
+        else
+            return false;
+
+        return true;
+    }
+
+    bool ParsePurgeAge(std::string_view purgeAge, Seconds& age)
+    {
+        age = Seconds(0);
+        purgeAge = TrimSpaces(purgeAge);
+
+        if (purgeAge.empty() || purgeAge == "none")
+            return true;
+
+        uint64 number;
+        std::string_view unit;
+        if (!SplitNumber(purgeAge, number, unit))
+            return false;
+
+        auto duration = unit.empty() ? Seconds(1) : GetUnitDuration(unit);
+        if (!duration)
+            return false;
+
+        age = *duration * number;
+        return true;
+    }
+
+    // Birth time of the file, 0 if the platform or file system does not keep it
+    std::time_t GetCreationTime(std::string const& path)
+    {
+#if WARHEAD_PLATFORM == WARHEAD_PLATFORM_WINDOWS
+        WIN32_FILE_ATTRIBUTE_DATA data;
+        if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &data))
+            return 0;
+
+        // 100 ns intervals since 1601-01-01
+        uint64 const time = (uint64(data.ftCreationTime.dwHighDateTime) << 32) | data.ftCreationTime.dwLowDateTime;
+        return static_cast<std::time_t>((time - 116444736000000000ULL) / 10000000ULL);
+#elif WARHEAD_PLATFORM == WARHEAD_PLATFORM_APPLE
+        struct stat info;
+        return stat(path.c_str(), &info) ? 0 : info.st_birthtime;
+#elif defined(STATX_BTIME)
+        struct statx info;
+        if (statx(AT_FDCWD, path.c_str(), 0, STATX_BTIME, &info) || !(info.stx_mask & STATX_BTIME))
+            return 0;
+
+        return static_cast<std::time_t>(info.stx_btime.tv_sec);
+#else
+        return 0;
+#endif
+    }
+
+    // Allocates the blocks of the file from offset up to size, a write through the mapping into a page
+    // without blocks raises SIGBUS on a full disk. Returns the error, empty on success
+    std::string ReserveFile(std::string const& path, uint64 offset, uint64 size)
+    {
+#if WARHEAD_PLATFORM == WARHEAD_PLATFORM_WINDOWS
+        (void)offset;
+
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return std::system_category().message(GetLastError());
+
+        // The new end of file gets its clusters allocated
+        LARGE_INTEGER end;
+        end.QuadPart = static_cast<LONGLONG>(size);
+        bool const reserved = SetFilePointerEx(file, end, nullptr, FILE_BEGIN) && SetEndOfFile(file);
+        DWORD const error = GetLastError();
+        CloseHandle(file);
+
+        return reserved ? std::string() : std::system_category().message(error);
+#else
+        int file = ::open(path.c_str(), O_WRONLY);
+        if (file < 0)
+            return std::strerror(errno);
+
+#if WARHEAD_PLATFORM == WARHEAD_PLATFORM_APPLE
+        // No posix_fallocate, allocate past the physical end of file and then extend it
+        fstore_t store{ F_ALLOCATEALL, F_PEOFPOSMODE, 0, static_cast<off_t>(size - offset), 0 };
+        int error = fcntl(file, F_PREALLOCATE, &store) == -1 || ftruncate(file, static_cast<off_t>(size)) ? errno : 0;
+#else
+        int error = posix_fallocate(file, static_cast<off_t>(offset), static_cast<off_t>(size - offset));
+#endif
+        ::close(file);
+
+        return error ? std::strerror(error) : std::string();
+#endif
+    }
+
+    bool IsTrue(std::string_view value)
+    {
+        return value.size() == 4 && std::equal(value.begin(), value.end(), "true", [](char a, char b)
+        {
+            return std::tolower(static_cast<unsigned char>(a)) == b;
+        });
+    }
+}
+
+LogFileChannel::LogFileChannel(Milliseconds syncInterval, uint64 syncSize) :
+    _syncInterval(std::max(syncInterval, Milliseconds(1))), _syncSize(std::max<uint64>(syncSize, 1)) { }
+
+LogFileChannel::~LogFileChannel()
+{
+    close();
+}
+
+bool LogFileChannel::IsSupportedRotation(std::string_view rotation)
+{
+    uint64 size;
+    Seconds interval;
+    return ParseRotation(rotation, size, interval);
+}
+
+void LogFileChannel::setProperty(std::string const& name, std::string const& value)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+
+    if (name == "path")
+        _path = value;
+    else if (name == "times")
+    {
+        if (value != "utc" && value != "local")
+            throw Poco::InvalidArgumentException("times", value);
+
+        _times = value;
+    }
+    else if (name == "rotation")
+    {
+        uint64 size;
+        Seconds interval;
+        if (!ParseRotation(value, size, interval))
+            throw Poco::InvalidArgumentException("rotation", value);
+
+        _rotation = value;
+        _rotateSize = size;
+        _rotateInterval = interval;
+    }
+    else if (name == "archive")
+    {
+        if (value != "number" && value != "timestamp")
+            throw Poco::InvalidArgumentException("archive", value);
+
+        _archive = value;
+    }
+    else if (name == "purgeAge")
+    {
+        Seconds age;
+        if (!ParsePurgeAge(value, age))
+            throw Poco::InvalidArgumentException("purgeAge", value);
+
+        _purgeAge = value;
+        _purgeAgeSeconds = age;
+    }
+    else if (name == "flush")
+        _flush = IsTrue(value);
+    else if (name == "rotateOnOpen")
+        _rotateOnOpen = IsTrue(value);
+    else if (name == "compress")
+        _compress = IsTrue(value);
+    else
+        Channel::setProperty(name, value);
+}
+
+std::string LogFileChannel::getProperty(std::string const& name) const
+{
+    if (name == "path")
+        return _path;
+    if (name == "times")
+        return _times;
+    if (name == "rotation")
+        return _rotation;
+    if (name == "archive")
+        return _archive;
+    if (name == "purgeAge")
+        return _purgeAge;
+    if (name == "flush")
+        return _flush ? "true" : "false";
+    if (name == "rotateOnOpen")
+        return _rotateOnOpen ? "true" : "false";
+    if (name == "compress")
+        return _compress ? "true" : "false";
+
+    return Channel::getProperty(name);
+}
+
+void LogFileChannel::open()
+{
+    std::unique_lock<std::mutex> lock(_lock);
+
+    try
+    {
+        EnsureOpened();
+    }
+    catch (std::exception const& e)
+    {
+        fmt::print("LogFileChannel: Can't open file '{}' - {}\n", _path, e.what());
+    }
+}
+
+void LogFileChannel::close()
+{
+    std::unique_lock<std::mutex> lock(_lock);
+
+    try
+    {
+        CloseFile(lock);
+    }
+    catch (std::exception const& e)
+    {
+        fmt::print("LogFileChannel: Can't close file '{}' - {}\n", _path, e.what());
+    }
+
+    // File is synced already, a delayed sync would only hold up the close
+    if (_delayedSyncJob && sThreadPool->Cancel(_delayedSyncJob))
+    {
+        _delayedSyncJob = 0;
+        FinishJob();
+    }
+
+    // Pending files are archived before the channel goes away, their jobs use it
+    _jobCondition.wait(lock, [this] { return !_pendingJobs && _archiveJobs.empty(); });
+}
+
+void LogFileChannel::log(Poco::Message const& msg)
+{
+    std::unique_lock<std::mutex> lock(_lock);
+
+    try
+    {
+        EnsureOpened();
+
+        if (NeedRotate())
+            Rotate(lock);
+
+        std::string const& text = msg.getText();
+        Append(text.data(), text.size());
+        Append("\n", 1);
+    }
+    catch (std::exception const& e)
+    {
+        fmt::print("LogFileChannel: Can't write to file '{}' - {}\n", _path, e.what());
+        return;
+    }
+
+    ScheduleSync();
+}
+
+void LogFileChannel::EnsureOpened()
+{
+    if (_opened)
+        return;
+
+    // Archived before the current file, in rotation order
+    QueueLeftovers();
+
+    if (_rotateOnOpen)
+        QueueArchive();
+
+    OpenFile();
+}
+
+void LogFileChannel::OpenFile()
+{
+    std::error_code error;
+    if (!fs::exists(_path, error))
+        std::ofstream(_path, std::ios::binary | std::ios::app).close();
+
+    _size = fs::file_size(_path);
+    _capacity = _size;
+    // Interval rotation counts from the creation of the file, a rotation creates a new one.
+    // Without a birth time it can only count from now
+    _creationTime = GetCreationTime(_path);
+    if (!_creationTime)
+        _creationTime = std::time(nullptr);
+
+    MapChunk(_size ? (_size - 1) & ~(ChunkSize - 1) : 0);
+    _opened = true;
+
+    // Zero bytes preallocated by a process that did not close the file
+    if (_chunk)
+    {
+        char const* data = static_cast<char const*>(_chunk->get_address());
+        while (_size > _chunkOffset && !data[_size - _chunkOffset - 1])
+            --_size;
+    }
+
+    _syncedSize = _size;
+}
+
+void LogFileChannel::CloseFile(std::unique_lock<std::mutex>& lock)
+{
+    if (!_opened)
+        return;
+
+    WaitSync(lock);
+
+    if (_flush)
+    {
+        for (Region const& chunk : _fullChunks)
+            chunk->flush();
+
+        if (_chunk && _size > _chunkOffset)
+            _chunk->flush(0, _size - _chunkOffset);
+    }
+
+    _fullChunks.clear();
+    _chunk.reset();
+    _opened = false;
+
+    // Mapped again on the next open, the disk may have space by then
+    if (_directFile.is_open())
+        _directFile.close();
+
+    fs::resize_file(_path, _size);
+    _size = 0;
+    _capacity = 0;
+    _chunkOffset = 0;
+    _syncedSize = 0;
+}
+
+bool LogFileChannel::NeedRotate() const
+{
+    if (!_size)
+        return false;
+
+    if (_rotateSize && _size >= _rotateSize)
+        return true;
+
+    return _rotateInterval.count() && std::time(nullptr) - _creationTime >= _rotateInterval.count();
+}
+
+void LogFileChannel::Rotate(std::unique_lock<std::mutex>& lock)
+{
+    // Another thread may have rotated while this one waited for the sync
+    WaitSync(lock);
+    if (!NeedRotate())
+        return;
+
+    CloseFile(lock);
+    QueueArchive();
+    OpenFile();
+}
+
+void LogFileChannel::QueueArchive()
+{
+    std::error_code error;
+    if (!fs::exists(_path, error) || !fs::file_size(_path, error))
+        return;
+
+    // Only a rename here, moving the older archives and purging is up to a pool job
+    std::string path = fmt::format("{}{}{}", _path, ROTATING_SUFFIX, ++_rotatedCount);
+    fs::rename(_path, path);
+
+    QueueArchiveJob(std::move(path), std::time(nullptr), false);
+}
+
+void LogFileChannel::QueueLeftovers()
+{
+    // Rotated files of a process that stopped before archiving them. Jobs of this channel are done,
+    // close waits for them
+    fs::path path(_path);
+    fs::path directory = path.has_parent_path() ? path.parent_path() : fs::path(".");
+    std::string const prefix = path.filename().string() + ROTATING_SUFFIX;
+
+    // Number -> file, a .gz next to the plain file is a compression cut short
+    std::map<uint32, std::pair<fs::path, bool>> leftovers;
+
+    std::error_code error;
+    for (auto const& entry : fs::directory_iterator(directory, error))
+    {
+        std::string name = entry.path().filename().string();
+        if (name.compare(0, prefix.size(), prefix))
+            continue;
+
+        bool const compressed = name.size() > 3 && !name.compare(name.size() - 3, 3, ".gz");
+        auto number = Warhead::StringTo<uint32>(std::string_view(name).substr(prefix.size(), name.size() - prefix.size() - (compressed ? 3 : 0)));
+        if (!number)
+            continue;
+
+        auto [itr, inserted] = leftovers.try_emplace(*number, entry.path(), compressed);
+        if (inserted)
+            continue;
+
+        std::error_code removeError;
+        fs::remove(compressed ? entry.path() : itr->second.first, removeError);
+        itr->second = { compressed ? itr->second.first : entry.path(), false };
+    }
+
+    for (auto& [number, leftover] : leftovers)
+    {
+        auto& [leftoverPath, compressed] = leftover;
+
+        std::error_code timeError;
+        auto const writeTime = fs::last_write_time(leftoverPath, timeError);
+        std::time_t time = std::time(nullptr);
+        if (!timeError)
+            time = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now() +
+                std::chrono::duration_cast<std::chrono::system_clock::duration>(writeTime - fs::file_time_type::clock::now()));
+
+        // Jobs of this process get the next numbers
+        _rotatedCount = std::max(_rotatedCount, number);
+
+        std::string jobPath = leftoverPath.string();
+        if (compressed)
+            jobPath.resize(jobPath.size() - 3);
+
+        QueueArchiveJob(std::move(jobPath), time, compressed);
+    }
+}
+
+void LogFileChannel::QueueArchiveJob(std::string path, std::time_t time, bool alreadyCompressed)
+{
+    auto job = std::make_shared<ArchiveJob>();
+    job->Path = std::move(path);
+    job->Time = time;
+    job->Compressed = alreadyCompressed;
+    job->Ready = alreadyCompressed || !_compress;
+    _archiveJobs.push_back(job);
+
+    if (!job->Ready)
+    {
+        sLogCompressor->Compress(job->Path, [this, job](bool compressed)
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            job->Compressed = compressed;
+            job->Ready = true;
+            ScheduleArchive();
+        });
+    }
+    else
+        ScheduleArchive();
+}
+
+void LogFileChannel::Append(char const* data, std::size_t size)
+{
+    while (size && !_directFile.is_open())
+    {
+        if (_size == _chunkOffset + ChunkSize)
+        {
+            if (_flush)
+                _fullChunks.push_back(std::move(_chunk));
+
+            MapChunk(_size);
+            continue;
+        }
+
+        std::size_t count = std::min<uint64>(size, _chunkOffset + ChunkSize - _size);
+        std::memcpy(static_cast<char*>(_chunk->get_address()) + (_size - _chunkOffset), data, count);
+
+        _size += count;
+        data += count;
+        size -= count;
+    }
+
+    if (size)
+        WriteDirect(data, size);
+}
+
+void LogFileChannel::MapChunk(uint64 offset)
+{
+    _chunk.reset();
+
+    if (offset + ChunkSize > _capacity)
+    {
+        std::string const error = ReserveFile(_path, _capacity, offset + ChunkSize);
+        if (!error.empty())
+        {
+            fmt::print("LogFileChannel: Can't preallocate file '{}' - {}, writing without the mapping\n", _path, error);
+            OpenDirect();
+            return;
+        }
+
+        _capacity = offset + ChunkSize;
+    }
+
+    boost::interprocess::file_mapping file(_path.c_str(), boost::interprocess::read_write);
+    _chunk = std::make_shared<boost::interprocess::mapped_region>(file, boost::interprocess::read_write, offset, ChunkSize);
+    _chunkOffset = offset;
+}
+
+void LogFileChannel::OpenDirect()
+{
+    // Written from _size, over the blocks preallocated before and past them. Truncated to _size on close like the mapped file
+    _directFile.open(_path, std::ios::binary | std::ios::in | std::ios::out);
+    if (_directFile.is_open())
+        _directFile.seekp(static_cast<std::streamoff>(_size));
+
+    if (!_directFile)
+    {
+        _directFile.close();
+        throw std::runtime_error("can't open the file for writing");
+    }
+}
+
+void LogFileChannel::WriteDirect(char const* data, std::size_t size)
+{
+    _directFile.write(data, static_cast<std::streamsize>(size));
+    if (_flush)
+        _directFile.flush();
+
+    if (!_directFile)
+    {
+        int const error = errno;
+
+        // Next record is written at the same place
+        _directFile.clear();
+        _directFile.seekp(static_cast<std::streamoff>(_size));
+        throw std::runtime_error(fmt::format("write failed - {}", std::strerror(error)));
+    }
+
+    // Flushed already, nothing for the sync jobs
+    _size += size;
+    _syncedSize = _size;
+}
+
+void LogFileChannel::WaitSync(std::unique_lock<std::mutex>& lock)
+{
+    _syncCondition.wait(lock, [this] { return !_syncing; });
+}
+
+// Jobs are submitted under the lock, the pool outlives the channels and never runs them inline
+void LogFileChannel::ScheduleSync()
+{
+    if (!_flush || !_opened || _size == _syncedSize || _directFile.is_open())
+        return;
+
+    if (_size - _syncedSize >= _syncSize)
+    {
+        // A delayed sync still pending just finds less to do
+        if (_syncQueued)
+            return;
+
+        _syncQueued = true;
+        ++_pendingJobs;
+        sThreadPool->Submit([this]() { SyncJob(false); });
+    }
+    else if (!_delayedSyncJob && !_syncQueued)
+    {
+        ++_pendingJobs;
+        _delayedSyncJob = sThreadPool->SubmitAfter(_syncInterval, [this]() { SyncJob(true); });
+    }
+}
+
+void LogFileChannel::ScheduleArchive()
+{
+    // One archive job at a time keeps the rotation order
+    if (_archiving || _archiveJobs.empty() || !_archiveJobs.front()->Ready)
+        return;
+
+    _archiving = true;
+    ++_pendingJobs;
+    sThreadPool->Submit([this]() { ArchiveJobs(); });
+}
+
+void LogFileChannel::SyncJob(bool delayed)
+{
+    std::unique_lock<std::mutex> lock(_lock);
+
+    // Writes from now on schedule the next sync
+    if (delayed)
+        _delayedSyncJob = 0;
+    else
+        _syncQueued = false;
+
+    WaitSync(lock);
+
+    // Sync outside of the lock, writers keep appending to the same chunk meanwhile
+    if (_flush && _opened && (_size > _syncedSize || !_fullChunks.empty()))
+    {
+        std::vector<Region> fullChunks;
+        fullChunks.swap(_fullChunks);
+
+        Region chunk = _chunk;
+        uint64 begin = std::max(_syncedSize, _chunkOffset) - _chunkOffset;
+        uint64 end = _size - _chunkOffset;
+        uint64 size = _size;
+        _syncing = true;
+
+        lock.unlock();
+
+        try
+        {
+            for (Region const& fullChunk : fullChunks)
+                fullChunk->flush();
+
+            if (chunk && end > begin)
+                chunk->flush(begin, end - begin);
+        }
+        catch (std::exception const& e)
+        {
+            fmt::print("LogFileChannel: Can't sync file '{}' - {}\n", _path, e.what());
+        }
+
+        fullChunks.clear();
+        chunk.reset();
+
+        lock.lock();
+
+        _syncing = false;
+        _syncedSize = size;
+        _syncCondition.notify_all();
+
+        // Written during the sync past the size limit
+        ScheduleSync();
+    }
+
+    FinishJob();
+}
+
+void LogFileChannel::ArchiveJobs()
+{
+    std::unique_lock<std::mutex> lock(_lock);
+
+    // In rotation order, a file still being compressed holds back the newer ones
+    std::vector<std::shared_ptr<ArchiveJob>> jobs;
+    while (!_archiveJobs.empty() && _archiveJobs.front()->Ready)
+    {
+        jobs.push_back(std::move(_archiveJobs.front()));
+        _archiveJobs.pop_front();
+    }
+
+    lock.unlock();
+
+    for (auto const& job : jobs)
+        Archive(*job);
+
+    if (_purgeAgeSeconds.count())
+        Purge();
+
+    lock.lock();
+
+    _archiving = false;
+    ScheduleArchive();
+    FinishJob();
+}
+
+void LogFileChannel::FinishJob()
+{
+    --_pendingJobs;
+    _jobCondition.notify_all();
+}
+
+void LogFileChannel::Archive(ArchiveJob const& job)
+{
+    std::error_code error;
+    std::string const source = job.Compressed ? job.Path + ".gz" : job.Path;
+    std::string_view const extension = job.Compressed ? ".gz" : "";
+
+    if (_archive == "timestamp")
+    {
+        std::tm time = _times == "utc" ? fmt::gmtime(job.Time) : fmt::localtime(job.Time);
+        std::string const archivePath = fmt::format("{}.{:%Y%m%d%H%M%S}", _path, time);
+
+        std::string path = fmt::format("{}{}", archivePath, extension);
+        for (uint32 i = 1; fs::exists(path, error); ++i)
+            path = fmt::format("{}.{}{}", archivePath, i, extension);
+
+        fs::rename(source, path, error);
+    }
+    else
+    {
+        // Newest archive is always .0, compressed and plain archives share the numbering
+        auto exists = [this](uint32 number)
+        {
+            std::error_code existsError;
+            return fs::exists(fmt::format("{}.{}", _path, number), existsError) ||
+                fs::exists(fmt::format("{}.{}.gz", _path, number), existsError);
+        };
+
+        uint32 count = 0;
+        while (exists(count))
+            ++count;
+
+        for (uint32 i = count; i > 0 && !error; --i)
+        {
+            for (std::string_view oldExtension : { "", ".gz" })
+            {
+                std::string const oldPath = fmt::format("{}.{}{}", _path, i - 1, oldExtension);
+                if (fs::exists(oldPath, error))
+                    fs::rename(oldPath, fmt::format("{}.{}{}", _path, i, oldExtension), error);
+            }
+        }
+
+        if (!error)
+            fs::rename(source, fmt::format("{}.0{}", _path, extension), error);
+    }
+
+    if (error)
+        fmt::print("LogFileChannel: Can't archive file '{}' - {}\n", source, error.message());
+}
+
+void LogFileChannel::Purge()
+{
+    fs::path path(_path);
+    fs::path directory = path.has_parent_path() ? path.parent_path() : fs::path(".");
+    std::string const prefix = path.filename().string() + ".";
+    auto const now = fs::file_time_type::clock::now();
+
+    std::error_code error;
+    for (auto const& entry : fs::directory_iterator(directory, error))
+    {
+        std::string const name = entry.path().filename().string();
+        if (name.compare(0, prefix.size(), prefix) || name.find(ROTATING_SUFFIX, prefix.size()) != std::string::npos)
+            continue;
+
+        std::error_code fileError;
+        auto const writeTime = entry.last_write_time(fileError);
+        if (!fileError && now - writeTime > _purgeAgeSeconds)
+            fs::remove(entry.path(), fileError);
+    }
+}
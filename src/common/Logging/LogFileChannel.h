@@ -0,0 +1,143 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LOG_FILE_CHANNEL_H_
+#define _LOG_FILE_CHANNEL_H_
+
+#include "Define.h"
+#include "Duration.h"
+#include <Poco/Channel.h>
+#include <condition_variable>
+#include <ctime>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace boost::interprocess
+{
+    class mapped_region;
+}
+
+// File channel appending into a preallocated memory mapped region of the file.
+// If the blocks can't be allocated (full disk) records are written to the file directly until it is reopened.
+// Takes the same properties as Poco::FileChannel (path, times, rotateOnOpen, rotation, flush, purgeAge, archive, compress).
+// With flush the mapped pages are synced in batches by jobs on the shared ThreadPool, after a time or a size limit,
+// archiving, purging and compression (LogCompressor) of rotated files also run there. Rotation at a time of day ("[day,][hh]:mm") is not supported.
+class WH_COMMON_API LogFileChannel : public Poco::Channel
+{
+public:
+    LogFileChannel(Milliseconds syncInterval, uint64 syncSize);
+
+    void open() override;
+    void close() override;
+    void log(Poco::Message const& msg) override;
+
+    void setProperty(std::string const& name, std::string const& value) override;
+    std::string getProperty(std::string const& name) const override;
+
+    static bool IsSupportedRotation(std::string_view rotation);
+
+    // File grows by this much, a multiple of the mapping granularity
+    static constexpr uint64 ChunkSize = 4 * 1024 * 1024;
+
+protected:
+    ~LogFileChannel() override;
+
+private:
+    using Region = std::shared_ptr<boost::interprocess::mapped_region>;
+
+    // Rotated file renamed to a temporary name, archived by a pool job in rotation order
+    // once it is compressed
+    struct ArchiveJob
+    {
+        std::string Path;
+        std::time_t Time;
+        bool Ready{ false };
+        bool Compressed{ false };
+    };
+
+    void EnsureOpened();
+    void OpenFile();
+    void CloseFile(std::unique_lock<std::mutex>& lock);
+    void Rotate(std::unique_lock<std::mutex>& lock);
+    bool NeedRotate() const;
+    void Append(char const* data, std::size_t size);
+    void MapChunk(uint64 offset);
+    void OpenDirect();
+    void WriteDirect(char const* data, std::size_t size);
+    void WaitSync(std::unique_lock<std::mutex>& lock);
+    void QueueArchive();
+    void QueueLeftovers();
+    void QueueArchiveJob(std::string path, std::time_t time, bool alreadyCompressed);
+
+    // Pool jobs, each holds one count of _pendingJobs
+    void ScheduleSync();
+    void ScheduleArchive();
+    void SyncJob(bool delayed);
+    void ArchiveJobs();
+    void FinishJob();
+
+    void Archive(ArchiveJob const& job);
+    void Purge();
+
+    // Properties
+    std::string _path;
+    std::string _times{ "utc" };
+    std::string _rotation{ "never" };
+    std::string _archive{ "number" };
+    std::string _purgeAge;
+    bool _rotateOnOpen{ false };
+    bool _flush{ true };
+    bool _compress{ false };
+    uint64 _rotateSize{ 0 };
+    Seconds _rotateInterval{ 0 };
+    Seconds _purgeAgeSeconds{ 0 };
+
+    Milliseconds _syncInterval;
+    uint64 _syncSize;
+
+    std::mutex _lock;
+    std::condition_variable _jobCondition;   // close waits for the pool jobs
+    std::condition_variable _syncCondition;  // rotation and close wait for a running sync
+
+    // Opened file
+    bool _opened{ false };
+    uint64 _size{ 0 };      // written bytes, the file is truncated to it on close
+    uint64 _capacity{ 0 };  // preallocated file size
+    uint64 _chunkOffset{ 0 };
+    Region _chunk;
+    std::ofstream _directFile; // open when the file could not grow, written instead of the mapping
+    std::time_t _creationTime{ 0 };
+
+    // Batched sync
+    uint64 _syncedSize{ 0 };
+    std::vector<Region> _fullChunks; // filled chunks waiting for a sync
+    bool _syncing{ false };
+    bool _syncQueued{ false };       // sync for the size limit, not started yet
+    uint64 _delayedSyncJob{ 0 };     // pool id of the sync for the time limit, not started yet
+
+    std::deque<std::shared_ptr<ArchiveJob>> _archiveJobs;
+    uint32 _rotatedCount{ 0 };
+    bool _archiving{ false };
+    uint32 _pendingJobs{ 0 };
+};
+
+#endif // _LOG_FILE_CHANNEL_H_
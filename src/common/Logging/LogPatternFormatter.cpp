@@ -0,0 +1,420 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "LogPatternFormatter.h"
+#include <Poco/DateTime.h>
+#include <Poco/DateTimeFormat.h>
+#include <Poco/DateTimeFormatter.h>
+#include <Poco/Environment.h>
+#include <Poco/Message.h>
+#include <Poco/Timestamp.h>
+#include <Poco/Timezone.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <string_view>
+#include <fmt/format.h>
+
+namespace
+{
+    constexpr std::string_view PriorityNames[] =
+    {
+        "", "Fatal", "Critical", "Error", "Warning", "Notice", "Information", "Debug", "Trace"
+    };
+
+    // Per thread copy of the per second segments of each formatter
+    struct SegmentCache
+    {
+        uint64 FormatterID{ 0 };
+        int64 Second{ 0 };
+        std::vector<std::string> Segments;
+    };
+
+    constexpr std::size_t MaxSegmentCaches = 32;
+
+    std::atomic<uint64> NextFormatterID{ 1 };
+    thread_local std::vector<SegmentCache> SegmentCaches;
+
+    bool IsPerSecondKey(char key)
+    {
+        switch (key)
+        {
+            case 'w': case 'W': case 'b': case 'B': case 'd': case 'e': case 'f': case 'm': case 'n': case 'o':
+            case 'y': case 'Y': case 'H': case 'h': case 'a': case 'A': case 'M': case 'S': case 'z': case 'Z': case 'E':
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    void AppendNumber(std::string& out, int64 value)
+    {
+        fmt::format_int number(value);
+        out.append(number.data(), number.size());
+    }
+
+    // Zero or space padded to width, like Poco::NumberFormatter::append0 and append
+    void AppendNumber(std::string& out, int64 value, std::size_t width, char fill)
+    {
+        fmt::format_int number(value);
+        if (number.size() < width)
+            out.append(width - number.size(), fill);
+
+        out.append(number.data(), number.size());
+    }
+
+    std::string_view GetPriorityName(Poco::Message::Priority priority)
+    {
+        return priority < std::size(PriorityNames) ? PriorityNames[priority] : "";
+    }
+}
+
+LogPatternFormatter::LogPatternFormatter() :
+    _id(NextFormatterID.fetch_add(1)), _nodeName(Poco::Environment::nodeName()) { }
+
+void LogPatternFormatter::setProperty(std::string const& name, std::string const& value)
+{
+    if (name == "pattern")
+    {
+        _pattern = value;
+        Compile();
+    }
+    else if (name == "times")
+    {
+        _localTime = value == "local";
+        Compile();
+    }
+    else
+        Formatter::setProperty(name, value);
+}
+
+std::string LogPatternFormatter::getProperty(std::string const& name) const
+{
+    if (name == "pattern")
+        return _pattern;
+
+    if (name == "times")
+        return _localTime ? "local" : "UTC";
+
+    return Formatter::getProperty(name);
+}
+
+void LogPatternFormatter::Compile()
+{
+    _id = NextFormatterID.fetch_add(1);
+    _ops.clear();
+    _segments.clear();
+
+    // Ops in pattern order, literals and per second fields are merged into cached segments below
+    std::vector<Op> ops;
+    bool local = _localTime;
+
+    auto addLiteral = [&ops](std::string_view text)
+    {
+        if (text.empty())
+            return;
+
+        if (!ops.empty() && ops.back().Type == OpType::Literal)
+            ops.back().Value.append(text);
+        else
+        {
+            Op op;
+            op.Type = OpType::Literal;
+            op.Value = text;
+            ops.push_back(std::move(op));
+        }
+    };
+
+    std::string_view pattern(_pattern);
+    std::size_t i = 0;
+
+    while (i < pattern.size())
+    {
+        std::size_t percent = pattern.find('%', i);
+        addLiteral(pattern.substr(i, percent == std::string_view::npos ? std::string_view::npos : percent - i));
+
+        if (percent == std::string_view::npos || percent + 1 >= pattern.size())
+            break;
+
+        i = percent + 1;
+        char key = pattern[i++];
+
+        Op op;
+        op.Local = local;
+
+        // %[name] or %key[width], an unclosed bracket takes the rest of the pattern
+        std::string_view argument;
+        bool hasArgument = false;
+
+        if (key == '[' || (i < pattern.size() && pattern[i] == '['))
+        {
+            std::size_t begin = key == '[' ? i : i + 1;
+            std::size_t end = pattern.find(']', begin);
+            argument = pattern.substr(begin, end == std::string_view::npos ? std::string_view::npos : end - begin);
+            hasArgument = true;
+            i = end == std::string_view::npos ? pattern.size() : end + 1;
+        }
+
+        if (key == '[')
+        {
+            op.Type = OpType::Property;
+            op.Value = argument;
+            ops.push_back(std::move(op));
+            continue;
+        }
+
+        if (IsPerSecondKey(key))
+        {
+            op.Type = OpType::Cached;
+            op.Key = key;
+            ops.push_back(std::move(op));
+            continue;
+        }
+
+        switch (key)
+        {
+            case 's': op.Type = OpType::Source; break;
+            case 't': op.Type = OpType::Text; break;
+            case 'l': op.Type = OpType::Priority; break;
+            case 'p': op.Type = OpType::PriorityName; break;
+            case 'q': op.Type = OpType::PriorityShort; break;
+            case 'P': op.Type = OpType::Pid; break;
+            case 'T': op.Type = OpType::Thread; break;
+            case 'I': op.Type = OpType::ThreadID; break;
+            case 'N': op.Type = OpType::Node; break;
+            case 'U': op.Type = OpType::SourceFile; break;
+            case 'O': op.Type = OpType::SourceFileName; break;
+            case 'u': op.Type = OpType::SourceLine; break;
+            case 'i': op.Type = OpType::Millisecond; break;
+            case 'c': op.Type = OpType::Centisecond; break;
+            case 'F': op.Type = OpType::Microsecond; break;
+            case 'v':
+                op.Type = OpType::SourceWidth;
+                op.Width = hasArgument ? std::strtoul(std::string(argument).c_str(), nullptr, 10) : 0;
+                break;
+            case 'L':
+                // Date and time after it are in local time
+                local = true;
+                continue;
+            default:
+                // Unknown keys write nothing, like Poco
+                continue;
+        }
+
+        ops.push_back(std::move(op));
+    }
+
+    // Runs of literals and per second fields become one cached segment if they hold a field
+    for (std::size_t begin = 0; begin < ops.size();)
+    {
+        std::size_t end = begin;
+        bool hasField = false;
+
+        while (end < ops.size() && (ops[end].Type == OpType::Literal || ops[end].Type == OpType::Cached))
+            hasField |= ops[end++].Type == OpType::Cached;
+
+        if (!hasField)
+        {
+            if (end == begin)
+                _ops.push_back(std::move(ops[end++]));
+            else
+                for (; begin < end; ++begin)
+                    _ops.push_back(std::move(ops[begin]));
+
+            begin = end;
+            continue;
+        }
+
+        Segment segment;
+        for (; begin < end; ++begin)
+            segment.Parts.push_back(std::move(ops[begin]));
+
+        Op op;
+        op.Type = OpType::Cached;
+        op.Index = static_cast<uint32>(_segments.size());
+        _ops.push_back(std::move(op));
+        _segments.push_back(std::move(segment));
+    }
+}
+
+void LogPatternFormatter::FormatSegment(Segment const& segment, int64 epochSeconds, std::string& out) const
+{
+    Poco::DateTime utcTime(Poco::Timestamp(epochSeconds * Poco::Timestamp::resolution()));
+    Poco::DateTime localTime = utcTime;
+    int tzd = Poco::DateTimeFormatter::UTC;
+
+    if (std::any_of(segment.Parts.begin(), segment.Parts.end(), [](Op const& op) { return op.Local; }))
+    {
+        tzd = Poco::Timezone::tzd();
+        localTime = Poco::DateTime(Poco::Timestamp((epochSeconds + Poco::Timezone::utcOffset() + Poco::Timezone::dst()) * Poco::Timestamp::resolution()));
+    }
+
+    for (Op const& part : segment.Parts)
+    {
+        if (part.Type == OpType::Literal)
+        {
+            out.append(part.Value);
+            continue;
+        }
+
+        Poco::DateTime const& dateTime = part.Local ? localTime : utcTime;
+
+        switch (part.Key)
+        {
+            case 'w': out.append(Poco::DateTimeFormat::WEEKDAY_NAMES[dateTime.dayOfWeek()], 0, 3); break;
+            case 'W': out.append(Poco::DateTimeFormat::WEEKDAY_NAMES[dateTime.dayOfWeek()]); break;
+            case 'b': out.append(Poco::DateTimeFormat::MONTH_NAMES[dateTime.month() - 1], 0, 3); break;
+            case 'B': out.append(Poco::DateTimeFormat::MONTH_NAMES[dateTime.month() - 1]); break;
+            case 'd': AppendNumber(out, dateTime.day(), 2, '0'); break;
+            case 'e': AppendNumber(out, dateTime.day()); break;
+            case 'f': AppendNumber(out, dateTime.day(), 2, ' '); break;
+            case 'm': AppendNumber(out, dateTime.month(), 2, '0'); break;
+            case 'n': AppendNumber(out, dateTime.month()); break;
+            case 'o': AppendNumber(out, dateTime.month(), 2, ' '); break;
+            case 'y': AppendNumber(out, dateTime.year() % 100, 2, '0'); break;
+            case 'Y': AppendNumber(out, dateTime.year(), 4, '0'); break;
+            case 'H': AppendNumber(out, dateTime.hour(), 2, '0'); break;
+            case 'h': AppendNumber(out, dateTime.hourAMPM(), 2, '0'); break;
+            case 'a': out.append(dateTime.isAM() ? "am" : "pm"); break;
+            case 'A': out.append(dateTime.isAM() ? "AM" : "PM"); break;
+            case 'M': AppendNumber(out, dateTime.minute(), 2, '0'); break;
+            case 'S': AppendNumber(out, dateTime.second(), 2, '0'); break;
+            case 'z': out.append(Poco::DateTimeFormatter::tzdISO(part.Local ? tzd : Poco::DateTimeFormatter::UTC)); break;
+            case 'Z': out.append(Poco::DateTimeFormatter::tzdRFC(part.Local ? tzd : Poco::DateTimeFormatter::UTC)); break;
+            case 'E': AppendNumber(out, epochSeconds); break;
+            default: break;
+        }
+    }
+}
+
+std::vector<std::string> const& LogPatternFormatter::GetCachedSegments(int64 epochSeconds)
+{
+    SegmentCache* cache = nullptr;
+
+    for (SegmentCache& segmentCache : SegmentCaches)
+    {
+        if (segmentCache.FormatterID == _id)
+        {
+            cache = &segmentCache;
+            break;
+        }
+    }
+
+    if (!cache)
+    {
+        // Caches of destroyed or recompiled formatters are never found again
+        if (SegmentCaches.size() >= MaxSegmentCaches)
+            SegmentCaches.clear();
+
+        cache = &SegmentCaches.emplace_back();
+        cache->FormatterID = _id;
+        cache->Second = epochSeconds - 1;
+    }
+
+    if (cache->Second != epochSeconds || cache->Segments.size() != _segments.size())
+    {
+        cache->Second = epochSeconds;
+        cache->Segments.resize(_segments.size());
+
+        for (std::size_t i = 0; i < _segments.size(); ++i)
+        {
+            cache->Segments[i].clear();
+            FormatSegment(_segments[i], epochSeconds, cache->Segments[i]);
+        }
+    }
+
+    return cache->Segments;
+}
+
+void LogPatternFormatter::format(Poco::Message const& msg, std::string& text)
+{
+    int64 const epochMicroseconds = msg.getTime().epochMicroseconds();
+    int64 epochSeconds = epochMicroseconds / Poco::Timestamp::resolution();
+    int64 microseconds = epochMicroseconds % Poco::Timestamp::resolution();
+    if (microseconds < 0)
+    {
+        --epochSeconds;
+        microseconds += Poco::Timestamp::resolution();
+    }
+
+    std::vector<std::string> const* segments = _segments.empty() ? nullptr : &GetCachedSegments(epochSeconds);
+
+    // Appended to text like Poco::PatternFormatter does, sized once for the segments, the message and a few short fields
+    std::size_t size = text.size() + msg.getText().size() + msg.getSource().size() + 64;
+
+    if (segments)
+        for (std::string const& segment : *segments)
+            size += segment.size();
+
+    text.reserve(size);
+    std::string& out = text;
+
+    for (Op const& op : _ops)
+    {
+        switch (op.Type)
+        {
+            case OpType::Literal: out.append(op.Value); break;
+            case OpType::Cached: out.append((*segments)[op.Index]); break;
+            case OpType::Source: out.append(msg.getSource()); break;
+            case OpType::Text: out.append(msg.getText()); break;
+            case OpType::Priority: AppendNumber(out, msg.getPriority()); break;
+            case OpType::PriorityName: out.append(GetPriorityName(msg.getPriority())); break;
+            case OpType::PriorityShort:
+            {
+                std::string_view name = GetPriorityName(msg.getPriority());
+                if (!name.empty())
+                    out.push_back(name.front());
+                break;
+            }
+            case OpType::Pid: AppendNumber(out, msg.getPid()); break;
+            case OpType::Thread: out.append(msg.getThread()); break;
+            case OpType::ThreadID: AppendNumber(out, msg.getTid()); break;
+            case OpType::Node: out.append(_nodeName); break;
+            case OpType::SourceFile:
+                if (char const* file = msg.getSourceFile())
+                    out.append(file);
+                break;
+            case OpType::SourceFileName:
+                if (char const* file = msg.getSourceFile())
+                {
+                    std::string_view path(file);
+                    std::size_t separator = path.find_last_of("/\\");
+                    out.append(separator == std::string_view::npos ? path : path.substr(separator + 1));
+                }
+                break;
+            case OpType::SourceLine: AppendNumber(out, msg.getSourceLine()); break;
+            case OpType::Millisecond: AppendNumber(out, microseconds / 1000, 3, '0'); break;
+            case OpType::Centisecond: AppendNumber(out, microseconds / 100000); break;
+            case OpType::Microsecond: AppendNumber(out, microseconds, 6, '0'); break;
+            case OpType::SourceWidth:
+            {
+                std::string const& source = msg.getSource();
+                if (op.Width > source.size())
+                    out.append(source).append(op.Width - source.size(), ' ');
+                else if (op.Width && op.Width < source.size())
+                    out.append(source, source.size() - op.Width, op.Width);
+                else
+                    out.append(source);
+                break;
+            }
+            case OpType::Property:
+                if (msg.has(op.Value))
+                    out.append(msg.get(op.Value));
+                break;
+        }
+    }
+}
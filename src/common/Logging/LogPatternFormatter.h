@@ -0,0 +1,95 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LOG_PATTERN_FORMATTER_H_
+#define _LOG_PATTERN_FORMATTER_H_
+
+#include "Define.h"
+#include <Poco/Formatter.h>
+#include <string>
+#include <vector>
+
+namespace Poco
+{
+    class Message;
+}
+
+// Poco::PatternFormatter pattern syntax, compiled once into a list of ops.
+// Date and time fields that change once per second are formatted once per second into a thread local cache
+// (one per formatting thread, the async writer thread in async mode), so most lines only copy the prefix.
+class WH_COMMON_API LogPatternFormatter : public Poco::Formatter
+{
+public:
+    LogPatternFormatter();
+
+    void format(Poco::Message const& msg, std::string& text) override;
+
+    void setProperty(std::string const& name, std::string const& value) override;
+    std::string getProperty(std::string const& name) const override;
+
+private:
+    enum class OpType : uint8
+    {
+        Literal,
+        Cached,         // literals and per second time fields, Index is the cached segment
+        Source,
+        SourceWidth,
+        Text,
+        Priority,
+        PriorityName,
+        PriorityShort,
+        Pid,
+        Thread,
+        ThreadID,
+        Node,
+        SourceFile,
+        SourceFileName,
+        SourceLine,
+        Millisecond,
+        Centisecond,
+        Microsecond,
+        Property
+    };
+
+    struct Op
+    {
+        OpType Type{ OpType::Literal };
+        char Key{ 0 };       // time field of a cached segment part
+        bool Local{ false }; // time field in local time
+        uint32 Index{ 0 };
+        std::size_t Width{ 0 };
+        std::string Value;   // literal text or property name
+    };
+
+    struct Segment
+    {
+        std::vector<Op> Parts; // literals and time fields
+    };
+
+    void Compile();
+    void FormatSegment(Segment const& segment, int64 epochSeconds, std::string& out) const;
+    std::vector<std::string> const& GetCachedSegments(int64 epochSeconds);
+
+    std::string _pattern;
+    bool _localTime{ false };
+    uint64 _id;
+    std::vector<Op> _ops;
+    std::vector<Segment> _segments;
+    std::string _nodeName;
+};
+
+#endif // _LOG_PATTERN_FORMATTER_H_
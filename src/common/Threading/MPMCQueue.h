@@ -0,0 +1,223 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MPMCQueue_h__
+#define MPMCQueue_h__
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace Warhead
+{
+namespace Impl
+{
+// Assumed cache line size, std::hardware_destructive_interference_size is not portable yet
+constexpr std::size_t MPMCQueueCacheLineSize = 64;
+
+// C++ implementation of Dmitry Vyukov's bounded lock free MPMC queue
+// http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+// Bulk operations claim a whole run of cells with a single CAS.
+template<typename T>
+class MPMCQueueBounded
+{
+    static_assert(std::is_nothrow_move_assignable_v<T> && std::is_default_constructible_v<T>, "MPMCQueueBounded element must be default constructible and nothrow move assignable");
+
+public:
+    // Capacity is rounded up to a power of two
+    explicit MPMCQueueBounded(std::size_t capacity)
+    {
+        _capacity = 2;
+        while (_capacity < capacity)
+            _capacity <<= 1;
+
+        _mask = _capacity - 1;
+        _buffer = std::make_unique<Cell[]>(_capacity);
+
+        for (std::size_t i = 0; i < _capacity; ++i)
+            _buffer[i].Sequence.store(i, std::memory_order_relaxed);
+
+        _enqueuePos.store(0, std::memory_order_relaxed);
+        _dequeuePos.store(0, std::memory_order_relaxed);
+    }
+
+    std::size_t GetCapacity() const { return _capacity; }
+
+    // Returns false if queue is full, input is left untouched then
+    bool Enqueue(T&& input)
+    {
+        Cell* cell;
+        std::size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+
+        for (;;)
+        {
+            cell = &_buffer[pos & _mask];
+            std::size_t seq = cell->Sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+
+            if (!diff)
+            {
+                if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false;
+            else
+                pos = _enqueuePos.load(std::memory_order_relaxed);
+        }
+
+        cell->Data = std::move(input);
+        cell->Sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Dequeue(T& result)
+    {
+        Cell* cell;
+        std::size_t pos = _dequeuePos.load(std::memory_order_relaxed);
+
+        for (;;)
+        {
+            cell = &_buffer[pos & _mask];
+            std::size_t seq = cell->Sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+
+            if (!diff)
+            {
+                if (_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false;
+            else
+                pos = _dequeuePos.load(std::memory_order_relaxed);
+        }
+
+        result = std::move(cell->Data);
+        cell->Sequence.store(pos + _capacity, std::memory_order_release);
+        return true;
+    }
+
+    // Moves up to count elements in, returns how many were enqueued
+    std::size_t EnqueueBulk(T* input, std::size_t count)
+    {
+        std::size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+
+        for (;;)
+        {
+            std::size_t free = CountCells(pos, count, 0);
+            if (!free)
+            {
+                // Cell at pos is either still filled from the previous lap (full) or was claimed by other producer
+                if (_buffer[pos & _mask].Sequence.load(std::memory_order_acquire) < pos)
+                    return 0;
+
+                pos = _enqueuePos.load(std::memory_order_relaxed);
+                continue;
+            }
+
+            if (_enqueuePos.compare_exchange_weak(pos, pos + free, std::memory_order_relaxed))
+            {
+                for (std::size_t i = 0; i < free; ++i)
+                {
+                    Cell& cell = _buffer[(pos + i) & _mask];
+                    cell.Data = std::move(input[i]);
+                    cell.Sequence.store(pos + i + 1, std::memory_order_release);
+                }
+
+                return free;
+            }
+        }
+    }
+
+    // Moves up to maxCount elements out into result, returns how many were dequeued
+    std::size_t DequeueBulk(T* result, std::size_t maxCount)
+    {
+        std::size_t pos = _dequeuePos.load(std::memory_order_relaxed);
+
+        for (;;)
+        {
+            std::size_t ready = CountCells(pos, maxCount, 1);
+            if (!ready)
+            {
+                // Cell at pos is either not written yet (empty) or was claimed by other consumer
+                if (_buffer[pos & _mask].Sequence.load(std::memory_order_acquire) < pos + 1)
+                    return 0;
+
+                pos = _dequeuePos.load(std::memory_order_relaxed);
+                continue;
+            }
+
+            if (_dequeuePos.compare_exchange_weak(pos, pos + ready, std::memory_order_relaxed))
+            {
+                for (std::size_t i = 0; i < ready; ++i)
+                {
+                    Cell& cell = _buffer[(pos + i) & _mask];
+                    result[i] = std::move(cell.Data);
+                    cell.Sequence.store(pos + i + _capacity, std::memory_order_release);
+                }
+
+                return ready;
+            }
+        }
+    }
+
+    // Approximate, exact only when no other thread uses the queue
+    bool IsEmpty() const
+    {
+        return _dequeuePos.load(std::memory_order_acquire) >= _enqueuePos.load(std::memory_order_acquire);
+    }
+
+private:
+    struct alignas(MPMCQueueCacheLineSize) Cell
+    {
+        std::atomic<std::size_t> Sequence;
+        T Data;
+    };
+
+    // Count of consecutive cells from pos with sequence == pos + i + offset
+    std::size_t CountCells(std::size_t pos, std::size_t maxCount, std::size_t offset) const
+    {
+        std::size_t count = 0;
+
+        while (count < maxCount && count < _capacity &&
+            _buffer[(pos + count) & _mask].Sequence.load(std::memory_order_acquire) == pos + count + offset)
+            ++count;
+
+        return count;
+    }
+
+    std::unique_ptr<Cell[]> _buffer;
+    std::size_t _capacity;
+    std::size_t _mask;
+
+    // Producers and consumers spin on different cache lines
+    alignas(MPMCQueueCacheLineSize) std::atomic<std::size_t> _enqueuePos;
+    alignas(MPMCQueueCacheLineSize) std::atomic<std::size_t> _dequeuePos;
+
+    MPMCQueueBounded(MPMCQueueBounded const&) = delete;
+    MPMCQueueBounded& operator=(MPMCQueueBounded const&) = delete;
+};
+}
+}
+
+template<typename T>
+using MPMCQueue = Warhead::Impl::MPMCQueueBounded<T>;
+
+#endif // MPMCQueue_h__
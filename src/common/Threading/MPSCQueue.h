@@ -18,7 +18,10 @@
 #ifndef MPSCQueue_h__
 #define MPSCQueue_h__
 
+#include <array>
 #include <atomic>
+#include <cstdint>
+#include <limits>
 #include <memory>
 #include <utility>
 
@@ -26,15 +29,124 @@ namespace Warhead
 {
 namespace Impl
 {
+// Lock free free-list of queue nodes, allocated by blocks and kept until the queue is destroyed.
+// Head stores (tag << 32) | (index + 1) so a node popped and pushed back between load and CAS (ABA) is detected.
+// Node must have std::atomic<uint32_t> PoolNext and uint32_t PoolIndex members.
+template<typename Node>
+class MPSCQueueNodePool
+{
+public:
+    static constexpr uint32_t BlockSize = 256;
+    static constexpr uint32_t MaxBlocks = 256;
+    static constexpr uint32_t NotPooled = std::numeric_limits<uint32_t>::max();
+
+    MPSCQueueNodePool()
+    {
+        for (auto& block : _blocks)
+            block.store(nullptr, std::memory_order_relaxed);
+    }
+
+    ~MPSCQueueNodePool()
+    {
+        for (auto& block : _blocks)
+            delete[] block.load(std::memory_order_relaxed);
+    }
+
+    Node* Allocate()
+    {
+        uint64_t head = _head.load(std::memory_order_acquire);
+
+        while (uint32_t index = static_cast<uint32_t>(head))
+        {
+            Node* node = GetNode(index - 1);
+            uint64_t next = NextTag(head) | node->PoolNext.load(std::memory_order_relaxed);
+
+            if (_head.compare_exchange_weak(head, next, std::memory_order_acquire, std::memory_order_acquire))
+                return node;
+        }
+
+        return AllocateBlock();
+    }
+
+    void Free(Node* node)
+    {
+        if (node->PoolIndex == NotPooled)
+        {
+            delete node;
+            return;
+        }
+
+        Push(node, node);
+    }
+
+private:
+    static uint64_t NextTag(uint64_t head)
+    {
+        return ((head >> 32) + 1) << 32;
+    }
+
+    Node* GetNode(uint32_t index) const
+    {
+        return _blocks[index / BlockSize].load(std::memory_order_acquire) + index % BlockSize;
+    }
+
+    // Pushes chain first..last already linked through PoolNext
+    void Push(Node* first, Node* last)
+    {
+        uint64_t head = _head.load(std::memory_order_relaxed);
+
+        do
+        {
+            last->PoolNext.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+        } while (!_head.compare_exchange_weak(head, NextTag(head) | (first->PoolIndex + 1), std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    Node* AllocateBlock()
+    {
+        // Claim a block slot without ever counting past MaxBlocks
+        uint32_t blockIndex = _blockCount.load(std::memory_order_relaxed);
+
+        do
+        {
+            if (blockIndex >= MaxBlocks)
+            {
+                // Pool is exhausted, fall back to the heap
+                Node* node = new Node();
+                node->PoolIndex = NotPooled;
+                return node;
+            }
+        } while (!_blockCount.compare_exchange_weak(blockIndex, blockIndex + 1, std::memory_order_relaxed));
+
+        Node* block = new Node[BlockSize];
+        for (uint32_t i = 0; i < BlockSize; ++i)
+        {
+            block[i].PoolIndex = blockIndex * BlockSize + i;
+            block[i].PoolNext.store(block[i].PoolIndex + 2, std::memory_order_relaxed);
+        }
+
+        _blocks[blockIndex].store(block, std::memory_order_release);
+
+        // First node goes to the caller, the rest to the free-list
+        Push(&block[1], &block[BlockSize - 1]);
+        return &block[0];
+    }
+
+    std::atomic<uint64_t> _head{ 0 };
+    std::atomic<uint32_t> _blockCount{ 0 };
+    std::array<std::atomic<Node*>, MaxBlocks> _blocks;
+};
+
 // C++ implementation of Dmitry Vyukov's lock free MPSC queue
 // http://www.1024cores.net/home/lock-free-algorithms/queues/non-intrusive-mpsc-node-based-queue
+// Nodes are recycled through a per-queue pool instead of a heap allocation for each element.
 template<typename T>
 class MPSCQueueNonIntrusive
 {
 public:
-    MPSCQueueNonIntrusive() : _head(new Node()), _tail(_head.load(std::memory_order_relaxed))
+    MPSCQueueNonIntrusive() : _head(_pool.Allocate()), _tail(_head.load(std::memory_order_relaxed))
     {
         Node* front = _head.load(std::memory_order_relaxed);
+        front->Data = nullptr;
         front->Next.store(nullptr, std::memory_order_relaxed);
     }
 
@@ -45,12 +157,15 @@ public:
             delete output;
 
         Node* front = _head.load(std::memory_order_relaxed);
-        delete front;
+        _pool.Free(front);
     }
 
     void Enqueue(T* input)
     {
-        Node* node = new Node(input);
+        Node* node = _pool.Allocate();
+        node->Data = input;
+        node->Next.store(nullptr, std::memory_order_relaxed);
+
         Node* prevHead = _head.exchange(node, std::memory_order_acq_rel);
         prevHead->Next.store(node, std::memory_order_release);
     }
@@ -64,23 +179,21 @@ public:
 
         result = next->Data;
         _tail.store(next, std::memory_order_release);
-        delete tail;
+        _pool.Free(tail);
         return true;
     }
 
 private:
     struct Node
     {
-        Node() = default;
-        explicit Node(T* data) : Data(data)
-        {
-            Next.store(nullptr, std::memory_order_relaxed);
-        }
-
-        T* Data;
-        std::atomic<Node*> Next;
+        T* Data{ nullptr };
+        std::atomic<Node*> Next{ nullptr };
+        std::atomic<uint32_t> PoolNext{ 0 };
+        uint32_t PoolIndex{ 0 };
     };
 
+    // Declared first, nodes must outlive the queue pointers
+    MPSCQueueNodePool<Node> _pool;
     std::atomic<Node*> _head;
     std::atomic<Node*> _tail;
 
@@ -19,32 +19,69 @@
 #define _PCQ_H
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <deque>
 #include <mutex>
-#include <queue>
 #include <type_traits>
 
 template <typename T>
 class ProducerConsumerQueue
 {
 private:
-    std::mutex _queueLock;
-    std::queue<T> _queue;
+    mutable std::mutex _queueLock;
+    std::deque<T> _queue;
     std::condition_variable _condition;
     std::atomic<bool> _shutdown;
 
+    // Consumers blocked in WaitAnd*, guarded by _queueLock. Lets producers skip notify when nobody waits
+    std::size_t _waiters{ 0 };
+
 public:
     ProducerConsumerQueue<T>() : _shutdown(false) { }
 
-    void Push(const T& value)
+    void Push(T const& value)
+    {
+        std::lock_guard<std::mutex> lock(_queueLock);
+        _queue.push_back(value);
+
+        NotifyOne();
+    }
+
+    void Push(T&& value)
+    {
+        std::lock_guard<std::mutex> lock(_queueLock);
+        _queue.push_back(std::move(value));
+
+        NotifyOne();
+    }
+
+    template<typename... Args>
+    void Emplace(Args&&... args)
     {
         std::lock_guard<std::mutex> lock(_queueLock);
-        _queue.push(std::move(value));
+        _queue.emplace_back(std::forward<Args>(args)...);
 
-        _condition.notify_one();
+        NotifyOne();
     }
 
-    bool Empty()
+    // Moves all elements of range in under one lock
+    template<typename Iterator>
+    void PushRange(Iterator begin, Iterator end)
+    {
+        std::lock_guard<std::mutex> lock(_queueLock);
+
+        std::size_t count = 0;
+        for (; begin != end; ++begin, ++count)
+            _queue.push_back(std::move(*begin));
+
+        if (count == 1)
+            NotifyOne();
+        else if (count)
+            NotifyAll();
+    }
+
+    bool Empty() const
     {
         std::lock_guard<std::mutex> lock(_queueLock);
 
@@ -53,6 +90,8 @@ public:
 
     [[nodiscard]] size_t Size() const
     {
+        std::lock_guard<std::mutex> lock(_queueLock);
+
         return _queue.size();
     }
 
@@ -65,13 +104,25 @@ public:
             return false;
         }
 
-        value = _queue.front();
-
-        _queue.pop();
+        PopFront(value);
 
         return true;
     }
 
+    // Takes whole backlog at once, values is cleared before. Returns count of taken elements
+    std::size_t PopAll(std::deque<T>& values)
+    {
+        values.clear();
+
+        std::lock_guard<std::mutex> lock(_queueLock);
+
+        if (_shutdown)
+            return 0;
+
+        values.swap(_queue);
+        return values.size();
+    }
+
     void WaitAndPop(T& value)
     {
         std::unique_lock<std::mutex> lock(_queueLock);
@@ -80,7 +131,7 @@ public:
         // https://connect.microsoft.com/VisualStudio/feedback/details/1098841
         while (_queue.empty() && !_shutdown)
         {
-            _condition.wait(lock);
+            Wait(lock);
         }
 
         if (_queue.empty() || _shutdown)
@@ -88,9 +139,49 @@ public:
             return;
         }
 
-        value = _queue.front();
+        PopFront(value);
+    }
+
+    // Returns false on timeout or shutdown
+    template<typename Rep, typename Period>
+    bool WaitAndPopFor(T& value, std::chrono::duration<Rep, Period> timeout)
+    {
+        auto const waitUntil = std::chrono::steady_clock::now() + timeout;
+        std::unique_lock<std::mutex> lock(_queueLock);
+
+        while (_queue.empty() && !_shutdown)
+        {
+            if (!Wait(lock, waitUntil))
+                break;
+        }
+
+        if (_queue.empty() || _shutdown)
+        {
+            return false;
+        }
+
+        PopFront(value);
+
+        return true;
+    }
+
+    // Waits for at least one element and takes whole backlog, see PopAll
+    std::size_t WaitAndPopAll(std::deque<T>& values)
+    {
+        values.clear();
+
+        std::unique_lock<std::mutex> lock(_queueLock);
+
+        while (_queue.empty() && !_shutdown)
+        {
+            Wait(lock);
+        }
+
+        if (_shutdown)
+            return 0;
 
-        _queue.pop();
+        values.swap(_queue);
+        return values.size();
     }
 
     void Cancel()
@@ -103,7 +194,7 @@ public:
 
             DeleteQueuedObject(value);
 
-            _queue.pop();
+            _queue.pop_front();
         }
 
         _shutdown = true;
@@ -112,6 +203,42 @@ public:
     }
 
 private:
+    void PopFront(T& value)
+    {
+        value = std::move(_queue.front());
+
+        _queue.pop_front();
+    }
+
+    void Wait(std::unique_lock<std::mutex>& lock)
+    {
+        ++_waiters;
+        _condition.wait(lock);
+        --_waiters;
+    }
+
+    bool Wait(std::unique_lock<std::mutex>& lock, std::chrono::steady_clock::time_point waitUntil)
+    {
+        ++_waiters;
+        bool const notified = _condition.wait_until(lock, waitUntil) == std::cv_status::no_timeout;
+        --_waiters;
+
+        return notified;
+    }
+
+    // Called with _queueLock held
+    void NotifyOne()
+    {
+        if (_waiters)
+            _condition.notify_one();
+    }
+
+    void NotifyAll()
+    {
+        if (_waiters)
+            _condition.notify_all();
+    }
+
     template<typename E = T>
     typename std::enable_if<std::is_pointer<E>::value>::type DeleteQueuedObject(E& obj) { delete obj; }
 
@@ -18,9 +18,15 @@
 #ifndef _PACKET_QUEUE_H_
 #define _PACKET_QUEUE_H_
 
+#include "Define.h"
+#include "MPMCQueue.h"
+#include <atomic>
 #include <deque>
-#include <mutex>
 #include <functional>
+#include <limits>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 namespace Warhead::Impl
 {
@@ -118,9 +124,86 @@ namespace Warhead::Impl
         }
     };
 
+    /// Growable ring of values stored contiguously, allocates only when it grows
+    template <typename T>
+    class RingBuffer
+    {
+    public:
+        bool Empty() const { return !_size; }
+        std::size_t Size() const { return _size; }
+
+        T& Front() { return _storage[_head]; }
+
+        void PushBack(T value)
+        {
+            Reserve(_size + 1);
+            _storage[(_head + _size) & (_storage.size() - 1)] = std::move(value);
+            ++_size;
+        }
+
+        void PushFront(T value)
+        {
+            Reserve(_size + 1);
+            _head = (_head - 1) & (_storage.size() - 1);
+            _storage[_head] = std::move(value);
+            ++_size;
+        }
+
+        void PopFront()
+        {
+            _head = (_head + 1) & (_storage.size() - 1);
+            --_size;
+        }
+
+        void Clear()
+        {
+            _head = 0;
+            _size = 0;
+        }
+
+        template<typename Callback>
+        void ForEach(Callback&& callback)
+        {
+            for (std::size_t i = 0; i < _size; ++i)
+                callback(_storage[(_head + i) & (_storage.size() - 1)]);
+        }
+
+    private:
+        void Reserve(std::size_t size)
+        {
+            if (size <= _storage.size())
+                return;
+
+            std::vector<T> storage(std::max<std::size_t>(16, _storage.size() * 2));
+            for (std::size_t i = 0; i < _size; ++i)
+                storage[i] = std::move(_storage[(_head + i) & (_storage.size() - 1)]);
+
+            _storage.swap(storage);
+            _head = 0;
+        }
+
+        std::vector<T> _storage; // size is always zero or a power of two
+        std::size_t _head{ 0 };
+        std::size_t _size{ 0 };
+    };
+
     template <typename Packet, typename Check>
     class CheckPacketQueue
     {
+        // Packets are partitioned by check value. Arrival order between partitions is kept
+        // by _order; entries of packets already taken through the partition are skipped lazily.
+        struct Entry
+        {
+            Packet* Data{ nullptr };
+            int64 Sequence{ 0 };
+        };
+
+        struct OrderEntry
+        {
+            Check Value{};
+            int64 Sequence{ 0 };
+        };
+
     public:
         using Element = std::pair<Packet*, Check>;
 
@@ -130,23 +213,19 @@ namespace Warhead::Impl
         //! Destroy a PacketQueue.
         ~CheckPacketQueue()
         {
-            for (auto& element : _queue)
-            {
-                delete element->first;
-                delete element;
-            }
-        }
-
-        auto GetElementType()
-        {
-            return Element;
+            for (auto& [check, partition] : _partitions)
+                partition.ForEach([](Entry& entry) { delete entry.Data; });
         }
 
         //! Adds an item to the queue.
-        void AddPacket(Packet* packet, Check nodeID)
+        void AddPacket(Packet* packet, Check check)
         {
             std::lock_guard<std::mutex> lock(_lock);
-            _queue.emplace_back(new std::pair(packet, nodeID));
+
+            int64 sequence = _backSequence++;
+            _partitions[check].PushBack({ packet, sequence });
+            _order.PushBack({ check, sequence });
+            ++_size;
         }
 
         //! Adds items back to front of the queue
@@ -154,24 +233,64 @@ namespace Warhead::Impl
         void ReadContainer(Container& container)
         {
             std::lock_guard<std::mutex> lock(_lock);
-            _queue.insert(_queue.begin(), std::begin(container), std::end(container));
+
+            for (auto itr = std::rbegin(container); itr != std::rend(container); ++itr)
+            {
+                int64 sequence = --_frontSequence;
+                _partitions[itr->second].PushFront({ itr->first, sequence });
+                _order.PushFront({ itr->second, sequence });
+                ++_size;
+            }
         }
 
         //! Gets the next result in the queue with check node id
-        bool GetNextPacket(Packet*& packet, Check& nodeID)
+        bool GetNextPacket(Packet*& packet, Check& check)
         {
             std::lock_guard<std::mutex> lock(_lock);
+            return PopNext(packet, check);
+        }
 
-            if (_queue.empty())
-                return false;
+        //! Gets the next result in the queue for one check node id only
+        bool GetNextPacket(Check check, Packet*& packet)
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            return PopNext(check, packet);
+        }
 
-            auto result = _queue.front();
-            packet = result->first;
-            nodeID = result->second;
+        //! Appends up to maxCount Elements in arrival order to container, returns how many were taken
+        template<class Container>
+        std::size_t GetNextPackets(Container& container, std::size_t maxCount = std::numeric_limits<std::size_t>::max())
+        {
+            std::lock_guard<std::mutex> lock(_lock);
 
-            _queue.pop_front();
+            std::size_t count = 0;
+            Element element;
 
-            return true;
+            while (count < maxCount && PopNext(element.first, element.second))
+            {
+                container.emplace_back(element);
+                ++count;
+            }
+
+            return count;
+        }
+
+        //! Appends up to maxCount packets of one check node id to container, returns how many were taken
+        template<class Container>
+        std::size_t GetNextPackets(Check check, Container& container, std::size_t maxCount = std::numeric_limits<std::size_t>::max())
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+
+            std::size_t count = 0;
+            Packet* packet{ nullptr };
+
+            while (count < maxCount && PopNext(check, packet))
+            {
+                container.emplace_back(packet);
+                ++count;
+            }
+
+            return count;
         }
 
         //! Cancels the queue.
@@ -192,21 +311,174 @@ namespace Warhead::Impl
         bool IsEmpty()
         {
             std::lock_guard<std::mutex> lock(_lock);
-            return _queue.empty();
+            return !_size;
+        }
+
+        std::size_t GetSize()
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            return _size;
         }
 
     private:
+        bool PopNext(Packet*& packet, Check& check)
+        {
+            while (!_order.Empty())
+            {
+                OrderEntry order = _order.Front();
+                _order.PopFront();
+
+                auto itr = _partitions.find(order.Value);
+                if (itr == _partitions.end() || itr->second.Empty() || itr->second.Front().Sequence != order.Sequence)
+                    continue; // already taken through its partition
+
+                packet = itr->second.Front().Data;
+                check = order.Value;
+                itr->second.PopFront();
+                OnPopped();
+                return true;
+            }
+
+            return false;
+        }
+
+        bool PopNext(Check check, Packet*& packet)
+        {
+            auto itr = _partitions.find(check);
+            if (itr == _partitions.end() || itr->second.Empty())
+                return false;
+
+            packet = itr->second.Front().Data;
+            itr->second.PopFront();
+            OnPopped();
+
+            // Keep stale order entries bounded when consumer takes only by partition
+            if (_order.Size() > 2 * _size + 64)
+                CompactOrder();
+
+            return true;
+        }
+
+        void CompactOrder()
+        {
+            // Partitions are sorted by sequence and popped from front, so entry is alive if not before the partition front
+            RingBuffer<OrderEntry> order;
+
+            _order.ForEach([&](OrderEntry const& entry)
+            {
+                auto itr = _partitions.find(entry.Value);
+                if (itr != _partitions.end() && !itr->second.Empty() && itr->second.Front().Sequence <= entry.Sequence)
+                    order.PushBack(entry);
+            });
+
+            std::swap(_order, order);
+        }
+
+        void OnPopped()
+        {
+            if (--_size)
+                return;
+
+            // Nothing left, drop stale order entries
+            _order.Clear();
+            _frontSequence = 0;
+            _backSequence = 0;
+        }
+
         //! Lock access to the queue.
         std::mutex _lock;
 
         //! Storage backing the queue.
-        std::deque<Element*> _queue;
+        std::unordered_map<Check, RingBuffer<Entry>> _partitions;
+        RingBuffer<OrderEntry> _order;
+        std::size_t _size{ 0 };
+        int64 _frontSequence{ 0 };
+        int64 _backSequence{ 0 };
 
         //! Cancellation flag.
         volatile bool _canceled{ false };
     };
 }
 
+namespace Warhead::Impl
+{
+    /// Lock free alternative of DefaultPacketQueue with fixed capacity,
+    /// for queues with many producers or hot paths where the mutex shows up.
+    template <typename Packet>
+    class RingPacketQueue
+    {
+    public:
+        //! Create a PacketQueue, capacity is rounded up to a power of two.
+        explicit RingPacketQueue(std::size_t capacity = 4096) : _queue(capacity) { }
+
+        //! Destroy a PacketQueue.
+        ~RingPacketQueue()
+        {
+            Packet* packet{ nullptr };
+
+            while (_queue.Dequeue(packet))
+                delete packet;
+        }
+
+        //! Adds an item to the queue, returns false and keeps the ownership if queue is full.
+        bool AddPacket(Packet* packet)
+        {
+            return _queue.Enqueue(std::move(packet));
+        }
+
+        //! Adds up to count items, returns how many were added.
+        std::size_t AddPackets(Packet** packets, std::size_t count)
+        {
+            return _queue.EnqueueBulk(packets, count);
+        }
+
+        //! Gets the next result in the queue, if any.
+        bool GetNextPacket(Packet*& result)
+        {
+            return _queue.Dequeue(result);
+        }
+
+        //! Gets up to maxCount results in the queue, returns how many were taken.
+        std::size_t GetNextPackets(Packet** result, std::size_t maxCount)
+        {
+            return _queue.DequeueBulk(result, maxCount);
+        }
+
+        //! Cancels the queue.
+        void Cancel()
+        {
+            _canceled.store(true, std::memory_order_release);
+        }
+
+        //! Checks if the queue is cancelled.
+        bool Cancelled() const
+        {
+            return _canceled.load(std::memory_order_acquire);
+        }
+
+        ///! Checks if we're empty or not, approximate when used by other threads
+        bool IsEmpty() const
+        {
+            return _queue.IsEmpty();
+        }
+
+        std::size_t GetCapacity() const
+        {
+            return _queue.GetCapacity();
+        }
+
+    private:
+        //! Storage backing the queue.
+        MPMCQueue<Packet*> _queue;
+
+        //! Cancellation flag.
+        std::atomic<bool> _canceled{ false };
+    };
+}
+
+template <typename Packet>
+using RingPacketQueue = Warhead::Impl::RingPacketQueue<Packet>;
+
 template <typename Packet, typename Check = void>
 using PacketQueue = std::conditional_t<std::is_integral<Check>::value, Warhead::Impl::CheckPacketQueue<Packet, Check>, Warhead::Impl::DefaultPacketQueue<Packet>>;
 
@@ -0,0 +1,419 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ThreadPool.h"
+#include "Log.h"
+#include <algorithm>
+
+namespace
+{
+    // Pool and worker index of the current thread, to push nested jobs to the own deque
+    thread_local Warhead::ThreadPool const* CurrentPool{ nullptr };
+    thread_local std::size_t CurrentWorker{ 0 };
+}
+
+Warhead::ThreadPool::ThreadPool(std::size_t threadCount /*= std::thread::hardware_concurrency()*/)
+{
+    threadCount = std::max<std::size_t>(1, threadCount);
+
+    _workers.reserve(threadCount);
+
+    for (std::size_t i = 0; i < threadCount; ++i)
+        _workers.emplace_back(std::make_unique<Worker>());
+
+    // Start after all workers exist, threads steal from each other right away
+    for (std::size_t i = 0; i < threadCount; ++i)
+        _workers[i]->Thread = std::thread(&ThreadPool::WorkerThread, this, i);
+}
+
+Warhead::ThreadPool::~ThreadPool()
+{
+    Stop();
+}
+
+Warhead::ThreadPool* Warhead::ThreadPool::instance()
+{
+    // Background jobs block on disk, keep one worker free on single core hosts
+    static ThreadPool instance(std::max<std::size_t>(2, std::thread::hardware_concurrency()));
+    return &instance;
+}
+
+void Warhead::ThreadPool::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_sleepLock);
+        _stopped = true;
+
+        // Delayed jobs are due now
+        _nextDelayedJob = TimePoint::min().time_since_epoch().count();
+    }
+
+    _sleepCondition.notify_all();
+
+    for (auto& worker : _workers)
+        if (worker->Thread.joinable())
+            worker->Thread.join();
+
+    _joined = true;
+
+    // Jobs pushed while the last worker was leaving
+    while (RunPendingJob()) { }
+}
+
+void Warhead::ThreadPool::Push(Job&& job)
+{
+    if (_joined)
+    {
+        job();
+        return;
+    }
+
+    std::size_t index = CurrentPool == this ? CurrentWorker : _nextWorker.fetch_add(1, std::memory_order_relaxed) % _workers.size();
+
+    // Counted before the job is visible, so a worker taking it never sees the counter below zero
+    _pending.fetch_add(1);
+
+    {
+        std::lock_guard<std::mutex> lock(_workers[index]->Lock);
+        _workers[index]->Jobs.emplace_back(std::move(job));
+    }
+
+    WakeUp(1);
+}
+
+void Warhead::ThreadPool::SubmitBulk(std::vector<Job>&& jobs)
+{
+    if (jobs.empty())
+        return;
+
+    if (_joined)
+    {
+        for (Job& job : jobs)
+            job();
+
+        jobs.clear();
+        return;
+    }
+
+    // Spread jobs over all deques, one lock per worker
+    std::size_t const first = _nextWorker.fetch_add(1, std::memory_order_relaxed);
+    std::size_t const count = std::min(jobs.size(), _workers.size());
+    std::size_t const jobsCount = jobs.size();
+
+    _pending.fetch_add(jobsCount);
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        Worker& worker = *_workers[(first + i) % _workers.size()];
+        std::lock_guard<std::mutex> lock(worker.Lock);
+
+        for (std::size_t j = i; j < jobs.size(); j += count)
+            worker.Jobs.emplace_back(std::move(jobs[j]));
+    }
+
+    WakeUp(jobsCount);
+    jobs.clear();
+}
+
+uint64 Warhead::ThreadPool::SubmitAfter(Milliseconds delay, Job&& job)
+{
+    if (_joined)
+    {
+        job();
+        return 0;
+    }
+
+    TimePoint const dueTime = std::chrono::steady_clock::now() + delay;
+    uint64 id;
+
+    {
+        std::lock_guard<std::mutex> lock(_sleepLock);
+        id = ++_nextDelayedJobId;
+
+        auto itr = _delayedJobs.emplace(dueTime, DelayedJob{ id, std::move(job) });
+        if (itr != _delayedJobs.begin())
+            return id;
+
+        if (!_stopped)
+            _nextDelayedJob = dueTime.time_since_epoch().count();
+    }
+
+    // New earliest job, a sleeping worker has to shorten its wait
+    _sleepCondition.notify_one();
+    return id;
+}
+
+bool Warhead::ThreadPool::Cancel(uint64 id)
+{
+    std::lock_guard<std::mutex> lock(_sleepLock);
+
+    // Few delayed jobs at a time, a linear search is fine
+    auto itr = std::find_if(_delayedJobs.begin(), _delayedJobs.end(), [id](auto const& pair) { return pair.second.Id == id; });
+    if (itr == _delayedJobs.end())
+        return false;
+
+    _delayedJobs.erase(itr);
+
+    if (!_stopped)
+        _nextDelayedJob = _delayedJobs.empty() ? TimePoint::max().time_since_epoch().count() : _delayedJobs.begin()->first.time_since_epoch().count();
+
+    return true;
+}
+
+void Warhead::ThreadPool::QueueDueJobs()
+{
+    if (_nextDelayedJob.load(std::memory_order_relaxed) > std::chrono::steady_clock::now().time_since_epoch().count())
+        return;
+
+    std::vector<Job> dueJobs;
+
+    {
+        std::lock_guard<std::mutex> lock(_sleepLock);
+
+        auto end = _stopped ? _delayedJobs.end() : _delayedJobs.upper_bound(std::chrono::steady_clock::now());
+        for (auto itr = _delayedJobs.begin(); itr != end;)
+        {
+            dueJobs.emplace_back(std::move(itr->second.Callback));
+            itr = _delayedJobs.erase(itr);
+        }
+
+        if (!_stopped)
+            _nextDelayedJob = _delayedJobs.empty() ? TimePoint::max().time_since_epoch().count() : _delayedJobs.begin()->first.time_since_epoch().count();
+    }
+
+    SubmitBulk(std::move(dueJobs));
+}
+
+void Warhead::ThreadPool::WakeUp(std::size_t count)
+{
+    // Pairs with the check of _pending in the sleep predicate, no notify when nobody sleeps
+    if (!_sleeping.load())
+        return;
+
+    std::lock_guard<std::mutex> lock(_sleepLock);
+
+    if (count == 1)
+        _sleepCondition.notify_one();
+    else
+        _sleepCondition.notify_all();
+}
+
+bool Warhead::ThreadPool::PopJob(std::size_t index, Job& job)
+{
+    Worker& worker = *_workers[index];
+    std::lock_guard<std::mutex> lock(worker.Lock);
+
+    if (worker.Jobs.empty())
+        return false;
+
+    job = std::move(worker.Jobs.back());
+    worker.Jobs.pop_back();
+    _pending.fetch_sub(1);
+    return true;
+}
+
+bool Warhead::ThreadPool::StealJob(std::size_t thief, Job& job)
+{
+    for (std::size_t i = 1; i <= _workers.size(); ++i)
+    {
+        std::size_t const index = (thief + i) % _workers.size();
+        if (index == thief && CurrentPool == this)
+            continue;
+
+        Worker& victim = *_workers[index];
+        std::lock_guard<std::mutex> lock(victim.Lock);
+
+        if (victim.Jobs.empty())
+            continue;
+
+        job = std::move(victim.Jobs.front());
+        victim.Jobs.pop_front();
+        _pending.fetch_sub(1);
+
+        if (CurrentPool == this)
+            _workers[thief]->Steals.fetch_add(1, std::memory_order_relaxed);
+
+        return true;
+    }
+
+    return false;
+}
+
+bool Warhead::ThreadPool::RunPendingJob()
+{
+    Job job;
+
+    if (CurrentPool == this)
+    {
+        if (!PopJob(CurrentWorker, job) && !StealJob(CurrentWorker, job))
+            return false;
+    }
+    else if (!StealJob(_nextWorker.load(std::memory_order_relaxed) % _workers.size(), job))
+        return false;
+
+    job();
+    return true;
+}
+
+void Warhead::ThreadPool::WorkerThread(std::size_t index)
+{
+    CurrentPool = this;
+    CurrentWorker = index;
+
+    Worker& worker = *_workers[index];
+    Job job;
+
+    for (;;)
+    {
+        QueueDueJobs();
+
+        if (PopJob(index, job) || StealJob(index, job))
+        {
+            try
+            {
+                job();
+            }
+            catch (std::exception const& e)
+            {
+                LOG_ERROR("server", "> ThreadPool: job failed with exception: {}", e.what());
+            }
+
+            job = nullptr;
+            worker.Executed.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(_sleepLock);
+
+        if (_stopped && !_pending.load() && _delayedJobs.empty())
+            break;
+
+        auto const idleStart = std::chrono::steady_clock::now();
+
+        // Checked after _sleeping is raised, a push in between notifies under the lock.
+        // Any wake up goes back to the loop, delayed jobs may have changed
+        _sleeping.fetch_add(1);
+
+        if (!_pending.load() && !_stopped)
+        {
+            if (_delayedJobs.empty())
+                _sleepCondition.wait(lock);
+            else
+            {
+                // A copy, Cancel may erase the job while waiting
+                TimePoint const dueTime = _delayedJobs.begin()->first;
+                _sleepCondition.wait_until(lock, dueTime);
+            }
+        }
+
+        _sleeping.fetch_sub(1);
+
+        worker.IdleMicroseconds.fetch_add(std::chrono::duration_cast<Microseconds>(std::chrono::steady_clock::now() - idleStart).count(), std::memory_order_relaxed);
+    }
+
+    CurrentPool = nullptr;
+}
+
+void Warhead::ThreadPool::ParallelFor(std::size_t begin, std::size_t end, std::function<void(std::size_t)> const& func, std::size_t grainSize /*= 0*/)
+{
+    if (begin >= end)
+        return;
+
+    std::size_t const count = end - begin;
+
+    if (!grainSize)
+        grainSize = std::max<std::size_t>(1, count / (_workers.size() * 4));
+
+    std::size_t const chunks = (count + grainSize - 1) / grainSize;
+
+    struct State
+    {
+        std::atomic<std::size_t> Next{ 0 };
+        std::atomic<std::size_t> Done{ 0 };
+        std::mutex ErrorLock;
+        std::exception_ptr Error;
+    };
+
+    auto state = std::make_shared<State>();
+
+    // Helpers started after all chunks are taken exit without touching func,
+    // so the reference is valid while it is used
+    auto runChunks = [state, begin, end, grainSize, chunks, &func]()
+    {
+        std::size_t chunk;
+
+        while ((chunk = state->Next.fetch_add(1)) < chunks)
+        {
+            std::size_t const chunkBegin = begin + chunk * grainSize;
+            std::size_t const chunkEnd = std::min(end, chunkBegin + grainSize);
+
+            try
+            {
+                for (std::size_t i = chunkBegin; i < chunkEnd; ++i)
+                    func(i);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(state->ErrorLock);
+                if (!state->Error)
+                    state->Error = std::current_exception();
+            }
+
+            state->Done.fetch_add(1, std::memory_order_release);
+        }
+    };
+
+    std::vector<Job> helpers(std::min(_workers.size(), chunks - 1), runChunks);
+    SubmitBulk(std::move(helpers));
+
+    runChunks();
+
+    // Remaining chunks are running on workers, help with other jobs meanwhile
+    while (state->Done.load(std::memory_order_acquire) < chunks)
+        if (!RunPendingJob())
+            std::this_thread::yield();
+
+    if (state->Error)
+        std::rethrow_exception(state->Error);
+}
+
+std::size_t Warhead::ThreadPool::GetQueueDepth() const
+{
+    return _pending.load(std::memory_order_relaxed);
+}
+
+std::vector<Warhead::ThreadPool::WorkerStats> Warhead::ThreadPool::GetStats() const
+{
+    std::vector<WorkerStats> stats;
+    stats.reserve(_workers.size());
+
+    for (auto const& worker : _workers)
+    {
+        WorkerStats& workerStats = stats.emplace_back();
+
+        {
+            std::lock_guard<std::mutex> lock(worker->Lock);
+            workerStats.QueueDepth = worker->Jobs.size();
+        }
+
+        workerStats.Executed = worker->Executed.load(std::memory_order_relaxed);
+        workerStats.Steals = worker->Steals.load(std::memory_order_relaxed);
+        workerStats.IdleTime = Microseconds(worker->IdleMicroseconds.load(std::memory_order_relaxed));
+    }
+
+    return stats;
+}
@@ -0,0 +1,147 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _WARHEAD_THREAD_POOL_H_
+#define _WARHEAD_THREAD_POOL_H_
+
+#include "Define.h"
+#include "Duration.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace Warhead
+{
+    /// Work stealing thread pool.
+    /// Each worker owns a deque: it pops own jobs from the back (newest, cache hot),
+    /// idle workers steal from the front of others. Jobs submitted from a worker
+    /// go to its own deque, jobs from other threads are spread round robin.
+    /// Delayed jobs wait in a timer list and are queued when due.
+    class WH_COMMON_API ThreadPool
+    {
+    public:
+        using Job = std::function<void()>;
+
+        struct WorkerStats
+        {
+            std::size_t QueueDepth{ 0 };
+            uint64 Executed{ 0 };
+            uint64 Steals{ 0 };
+            Microseconds IdleTime{ 0 };
+        };
+
+        explicit ThreadPool(std::size_t threadCount = std::thread::hardware_concurrency());
+        ~ThreadPool();
+
+        ThreadPool(ThreadPool const&) = delete;
+        ThreadPool& operator=(ThreadPool const&) = delete;
+
+        /// Pool shared by background jobs of the process (log sync, archive, compression).
+        /// Jobs must not block on each other, the pool has at least 2 workers
+        static ThreadPool* instance();
+
+        /// Queues callable, returned future gets its result or exception
+        template<typename Callable>
+        auto Submit(Callable&& callable) -> std::future<std::invoke_result_t<std::decay_t<Callable>>>
+        {
+            using Result = std::invoke_result_t<std::decay_t<Callable>>;
+
+            auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Callable>(callable));
+            std::future<Result> future = task->get_future();
+
+            Push([task]() { (*task)(); });
+            return future;
+        }
+
+        /// Queues all jobs with one wake up of the workers
+        void SubmitBulk(std::vector<Job>&& jobs);
+
+        /// Queues job after delay, returned id can cancel it until then
+        uint64 SubmitAfter(Milliseconds delay, Job&& job);
+
+        /// Removes a delayed job that is not queued yet, false if it already is (or ran)
+        bool Cancel(uint64 id);
+
+        /// Calls func(i) for each i in [begin, end) split into chunks of grainSize (0 - split by thread count).
+        /// Calling thread takes part and returns when all are done. First exception is rethrown.
+        void ParallelFor(std::size_t begin, std::size_t end, std::function<void(std::size_t)> const& func, std::size_t grainSize = 0);
+
+        /// Runs one queued job on the calling thread, if any
+        bool RunPendingJob();
+
+        /// Stops workers after all queued and delayed jobs are done, delayed ones run right away.
+        /// Jobs submitted after that run on the calling thread
+        void Stop();
+
+        std::size_t GetThreadCount() const { return _workers.size(); }
+        std::size_t GetQueueDepth() const;
+        std::vector<WorkerStats> GetStats() const;
+
+    private:
+        struct Worker
+        {
+            mutable std::mutex Lock;
+            std::deque<Job> Jobs;
+            std::thread Thread;
+
+            std::atomic<uint64> Executed{ 0 };
+            std::atomic<uint64> Steals{ 0 };
+            std::atomic<int64> IdleMicroseconds{ 0 };
+        };
+
+        void Push(Job&& job);
+        void WorkerThread(std::size_t index);
+        bool PopJob(std::size_t index, Job& job);
+        bool StealJob(std::size_t thief, Job& job);
+        void WakeUp(std::size_t count);
+        void QueueDueJobs();
+
+        std::vector<std::unique_ptr<Worker>> _workers;
+        std::atomic<std::size_t> _nextWorker{ 0 };
+
+        // Jobs queued and not taken yet, workers sleep only when it is zero
+        std::atomic<std::size_t> _pending{ 0 };
+        std::atomic<std::size_t> _sleeping{ 0 };
+        std::mutex _sleepLock;
+        std::condition_variable _sleepCondition;
+        std::atomic<bool> _stopped{ false };
+        std::atomic<bool> _joined{ false };
+
+        struct DelayedJob
+        {
+            uint64 Id{ 0 };
+            Job Callback;
+        };
+
+        // Guarded by _sleepLock, the earliest due time is mirrored for a lock free check
+        std::multimap<TimePoint, DelayedJob> _delayedJobs;
+        std::atomic<TimePoint::rep> _nextDelayedJob{ TimePoint::max().time_since_epoch().count() };
+        uint64 _nextDelayedJobId{ 0 };
+    };
+}
+
+#define sThreadPool Warhead::ThreadPool::instance()
+
+#endif
@@ -19,7 +19,10 @@
 #define AsyncCallbackProcessor_h__
 
 #include "Define.h"
+#include "MPSCQueue.h"
 #include <algorithm>
+#include <atomic>
+#include <memory>
 #include <vector>
 
 //template <class T>
@@ -60,4 +63,108 @@ private:
     std::vector<T> _callbacks;
 };
 
+// Completion driven variant of AsyncCallbackProcessor. AddCallback returns a Notifier, the async operation
+// calls Notify from any thread when it completes, which pushes the callback onto a lock free ready list.
+// ProcessReadyCallbacks only touches callbacks notified since the last call, so the cost per tick scales
+// with completions and not with the number of pending callbacks.
+// If InvokeIfReady returns false the callback stays pending until the next Notify.
+// A callback whose notifiers are all destroyed without Notify is dropped without being invoked.
+template<typename T> // requires AsyncCallback<T>
+class AsyncReadyCallbackProcessor
+{
+    struct Entry
+    {
+        explicit Entry(T&& callback) : Callback(std::move(callback)) { }
+
+        T Callback;
+        std::atomic<Entry*> ReadyLink{ nullptr };
+        std::atomic<bool> Queued{ false };
+        std::shared_ptr<Entry> QueuedRef; // keeps the entry alive while it is in the ready list
+        bool Done{ false }; // owner thread only
+    };
+
+    struct ReadyList
+    {
+        ReadyList() = default;
+
+        ~ReadyList()
+        {
+            // Entries are owned by shared_ptr, release the queue references instead of letting the queue delete them
+            Entry* entry{ nullptr };
+            while (Queue.Dequeue(entry))
+                entry->QueuedRef.reset();
+        }
+
+        MPSCQueue<Entry, &Entry::ReadyLink> Queue;
+
+        ReadyList(ReadyList const&) = delete;
+        ReadyList& operator=(ReadyList const&) = delete;
+    };
+
+public:
+    class Notifier
+    {
+    public:
+        Notifier() = default;
+        Notifier(std::shared_ptr<Entry> entry, std::shared_ptr<ReadyList> readyList) :
+            _entry(std::move(entry)), _readyList(std::move(readyList)) { }
+
+        // Thread safe. Repeated notifications before the callback is processed are merged
+        void Notify() const
+        {
+            if (!_entry || _entry->Queued.exchange(true, std::memory_order_acq_rel))
+                return;
+
+            _entry->QueuedRef = _entry;
+            _readyList->Queue.Enqueue(_entry.get());
+        }
+
+        explicit operator bool() const { return _entry != nullptr; }
+
+    private:
+        std::shared_ptr<Entry> _entry;
+        std::shared_ptr<ReadyList> _readyList;
+    };
+
+    AsyncReadyCallbackProcessor() : _readyList(std::make_shared<ReadyList>()) { }
+    ~AsyncReadyCallbackProcessor() = default;
+
+    Notifier AddCallback(T&& callback)
+    {
+        return Notifier(std::make_shared<Entry>(std::move(callback)), _readyList);
+    }
+
+    void ProcessReadyCallbacks()
+    {
+        // Take only what is ready now, callbacks notified while invoking wait for the next call
+        Entry* entry{ nullptr };
+        while (_readyList->Queue.Dequeue(entry))
+            _batch.emplace_back(std::move(entry->QueuedRef));
+
+        for (std::shared_ptr<Entry>& ready : _batch)
+        {
+            if (ready->Done)
+                continue;
+
+            // Cleared before invoking so a completion racing with InvokeIfReady queues the callback again
+            ready->Queued.store(false, std::memory_order_release);
+
+            if (ready->Callback.InvokeIfReady())
+            {
+                ready->Done = true;
+                ready->Queued.store(true, std::memory_order_release); // ignore late notifications
+            }
+        }
+
+        _batch.clear();
+    }
+
+private:
+    AsyncReadyCallbackProcessor(AsyncReadyCallbackProcessor const&) = delete;
+    AsyncReadyCallbackProcessor& operator=(AsyncReadyCallbackProcessor const&) = delete;
+
+    std::shared_ptr<ReadyList> _readyList;
+    std::vector<std::shared_ptr<Entry>> _batch;
+};
+
 #endif // AsyncCallbackProcessor_h__
@@ -0,0 +1,164 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WARHEAD_MOVE_ONLY_FUNCTION_H
+#define WARHEAD_MOVE_ONLY_FUNCTION_H
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace Warhead
+{
+    template<typename Signature, std::size_t BufferSize = 48>
+    class MoveOnlyFunction;
+
+    /// Move only replacement of std::function.
+    /// Callables up to BufferSize bytes (and nothrow movable) are stored inline without a heap allocation,
+    /// move only callables (capturing unique_ptr for example) are accepted too.
+    template<typename R, typename... Args, std::size_t BufferSize>
+    class MoveOnlyFunction<R(Args...), BufferSize>
+    {
+        struct VTable
+        {
+            R(*Invoke)(void* storage, Args&&... args);
+            void(*Move)(void* destination, void* source) noexcept;
+            void(*Destroy)(void* storage) noexcept;
+        };
+
+        template<typename F>
+        static constexpr bool IsInline = sizeof(F) <= BufferSize && alignof(F) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible_v<F>;
+
+        template<typename F>
+        static F* GetInline(void* storage) { return std::launder(reinterpret_cast<F*>(storage)); }
+
+        template<typename F>
+        static F* GetHeap(void* storage) { return *reinterpret_cast<F**>(storage); }
+
+        template<typename F>
+        static constexpr VTable InlineVTable =
+        {
+            [](void* storage, Args&&... args) -> R { return std::invoke(*GetInline<F>(storage), std::forward<Args>(args)...); },
+            [](void* destination, void* source) noexcept
+            {
+                ::new (destination) F(std::move(*GetInline<F>(source)));
+                GetInline<F>(source)->~F();
+            },
+            [](void* storage) noexcept { GetInline<F>(storage)->~F(); }
+        };
+
+        template<typename F>
+        static constexpr VTable HeapVTable =
+        {
+            [](void* storage, Args&&... args) -> R { return std::invoke(*GetHeap<F>(storage), std::forward<Args>(args)...); },
+            [](void* destination, void* source) noexcept { *reinterpret_cast<F**>(destination) = GetHeap<F>(source); },
+            [](void* storage) noexcept { delete GetHeap<F>(storage); }
+        };
+
+    public:
+        MoveOnlyFunction() noexcept = default;
+        MoveOnlyFunction(std::nullptr_t) noexcept { }
+
+        template<typename F, typename Callable = std::decay_t<F>,
+            typename = std::enable_if_t<!std::is_same_v<Callable, MoveOnlyFunction> && std::is_invocable_r_v<R, Callable&, Args...>>>
+        MoveOnlyFunction(F&& callable)
+        {
+            if constexpr (std::is_pointer_v<std::remove_reference_t<F>> || std::is_member_pointer_v<std::remove_reference_t<F>>)
+                if (!callable)
+                    return;
+
+            if constexpr (IsInline<Callable>)
+            {
+                ::new (static_cast<void*>(&_storage)) Callable(std::forward<F>(callable));
+                _vtable = &InlineVTable<Callable>;
+            }
+            else
+            {
+                *reinterpret_cast<Callable**>(&_storage) = new Callable(std::forward<F>(callable));
+                _vtable = &HeapVTable<Callable>;
+            }
+        }
+
+        MoveOnlyFunction(MoveOnlyFunction&& right) noexcept : _vtable(right._vtable)
+        {
+            if (_vtable)
+            {
+                _vtable->Move(&_storage, &right._storage);
+                right._vtable = nullptr;
+            }
+        }
+
+        MoveOnlyFunction& operator=(MoveOnlyFunction&& right) noexcept
+        {
+            if (this != &right)
+            {
+                Reset();
+
+                if (right._vtable)
+                {
+                    right._vtable->Move(&_storage, &right._storage);
+                    _vtable = right._vtable;
+                    right._vtable = nullptr;
+                }
+            }
+
+            return *this;
+        }
+
+        MoveOnlyFunction& operator=(std::nullptr_t) noexcept
+        {
+            Reset();
+            return *this;
+        }
+
+        MoveOnlyFunction(MoveOnlyFunction const&) = delete;
+        MoveOnlyFunction& operator=(MoveOnlyFunction const&) = delete;
+
+        ~MoveOnlyFunction()
+        {
+            Reset();
+        }
+
+        explicit operator bool() const noexcept { return _vtable != nullptr; }
+
+        R operator()(Args... args) const
+        {
+            if (!_vtable)
+                throw std::bad_function_call();
+
+            return _vtable->Invoke(&_storage, std::forward<Args>(args)...);
+        }
+
+    private:
+        void Reset() noexcept
+        {
+            if (_vtable)
+            {
+                _vtable->Destroy(&_storage);
+                _vtable = nullptr;
+            }
+        }
+
+        // Mutable: like std::function, the stored callable may change its own state when called
+        mutable std::aligned_storage_t<BufferSize, alignof(std::max_align_t)> _storage;
+        VTable const* _vtable{ nullptr };
+    };
+}
+
+#endif // WARHEAD_MOVE_ONLY_FUNCTION_H
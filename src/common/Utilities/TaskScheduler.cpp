@@ -36,12 +36,47 @@ TaskScheduler& TaskScheduler::Update(size_t const milliseconds, success_t const&
     return Update(std::chrono::milliseconds(milliseconds), callback);
 }
 
-TaskScheduler& TaskScheduler::Async(std::function<void()> const& callable)
+TaskScheduler& TaskScheduler::Async(Warhead::MoveOnlyFunction<void()> callable)
 {
-    _asyncHolder.push(callable);
+    _asyncHolder.push(std::move(callable));
     return *this;
 }
 
+TaskScheduler& TaskScheduler::AsyncFromAnyThread(Warhead::MoveOnlyFunction<void()> callable)
+{
+    InboxEntry* entry = new InboxEntry();
+    entry->Async = std::move(callable);
+    _inbox.Enqueue(entry);
+    return *this;
+}
+
+TaskScheduler& TaskScheduler::PostToInbox(duration_t const& time, std::optional<group_t> const& group, task_handler_t&& task)
+{
+    InboxEntry* entry = new InboxEntry();
+    entry->Time = time;
+    entry->Group = group;
+    entry->Task = std::move(task);
+    _inbox.Enqueue(entry);
+    return *this;
+}
+
+void TaskScheduler::ProcessInbox()
+{
+    InboxEntry* entry{ nullptr };
+
+    while (_inbox.Dequeue(entry))
+    {
+        if (entry->Async)
+            Async(std::move(entry->Async));
+        else if (entry->Group)
+            Schedule(entry->Time, *entry->Group, std::move(entry->Task));
+        else
+            Schedule(entry->Time, std::move(entry->Task));
+
+        delete entry;
+    }
+}
+
 TaskScheduler& TaskScheduler::CancelAll()
 {
     /// Clear the task holder
@@ -52,10 +87,7 @@ TaskScheduler& TaskScheduler::CancelAll()
 
 TaskScheduler& TaskScheduler::CancelGroup(group_t const group)
 {
-    _task_holder.RemoveIf([group](TaskContainer const & task) -> bool
-    {
-        return task->IsInGroup(group);
-    });
+    _task_holder.RemoveGroup(group);
     return *this;
 }
 
@@ -67,6 +99,113 @@ TaskScheduler& TaskScheduler::CancelGroupsOf(std::vector<group_t> const& groups)
     return *this;
 }
 
+namespace
+{
+    /// Free-list of task blocks (Task with its shared_ptr control block) of the current thread.
+    /// Trivially destructible, so tasks released during thread or program exit can still use it.
+    struct TaskBlockPool
+    {
+        static constexpr std::size_t MaxFreeBlocks = 1024;
+
+        struct FreeBlock
+        {
+            FreeBlock* Next;
+        };
+
+        FreeBlock* Free;
+        std::size_t Count;
+        std::size_t BlockSize; // only one block size is pooled, set by the first released block
+        bool Closed;
+
+        void* Allocate(std::size_t size)
+        {
+            if (size != BlockSize || !Free)
+                return ::operator new(size);
+
+            FreeBlock* block = Free;
+            Free = block->Next;
+            --Count;
+            return block;
+        }
+
+        void Deallocate(void* pointer, std::size_t size);
+
+        void Release()
+        {
+            while (FreeBlock* block = Free)
+            {
+                Free = block->Next;
+                ::operator delete(block);
+            }
+
+            Count = 0;
+            Closed = true;
+        }
+    };
+
+    thread_local TaskBlockPool TaskPool{};
+
+    /// Releases the free-list at thread exit
+    struct TaskBlockPoolCleanup
+    {
+        ~TaskBlockPoolCleanup() { TaskPool.Release(); }
+    };
+
+    thread_local TaskBlockPoolCleanup TaskPoolCleanup;
+
+    void TaskBlockPool::Deallocate(void* pointer, std::size_t size)
+    {
+        if (!BlockSize)
+        {
+            BlockSize = size;
+            (void)&TaskPoolCleanup; // odr-use, registers the cleanup of this thread
+        }
+
+        if (Closed || size != BlockSize || Count >= MaxFreeBlocks)
+        {
+            ::operator delete(pointer);
+            return;
+        }
+
+        Free = ::new (pointer) FreeBlock{ Free };
+        ++Count;
+    }
+
+    template<typename T>
+    struct TaskAllocator
+    {
+        using value_type = T;
+
+        TaskAllocator() = default;
+
+        template<typename U>
+        TaskAllocator(TaskAllocator<U> const&) { }
+
+        T* allocate(std::size_t count)
+        {
+            static_assert(sizeof(T) >= sizeof(void*), "Task block too small for the free-list");
+            return static_cast<T*>(TaskPool.Allocate(sizeof(T) * count));
+        }
+
+        void deallocate(T* pointer, std::size_t count)
+        {
+            TaskPool.Deallocate(pointer, sizeof(T) * count);
+        }
+
+        template<typename U>
+        bool operator==(TaskAllocator<U> const&) const { return true; }
+
+        template<typename U>
+        bool operator!=(TaskAllocator<U> const&) const { return false; }
+    };
+}
+
+/*static*/ auto TaskScheduler::MakeTask(timepoint_t const& end, duration_t const& duration, std::optional<group_t> const& group, task_handler_t&& task) -> TaskContainer
+{
+    static repeated_t const DEFAULT_REPEATED = 0;
+    return std::allocate_shared<Task>(TaskAllocator<Task>(), end, duration, group, DEFAULT_REPEATED, std::move(task));
+}
+
 TaskScheduler& TaskScheduler::InsertTask(TaskContainer task)
 {
     _task_holder.Push(std::move(task));
@@ -75,6 +214,9 @@ TaskScheduler& TaskScheduler::InsertTask(TaskContainer task)
 
 void TaskScheduler::Dispatch(success_t const& callback)
 {
+    // Tasks from other threads are queued even if the validation fails below
+    ProcessInbox();
+
     // If the validation failed abort the dispatching here.
     if (!_predicate())
     {
@@ -94,16 +236,11 @@ void TaskScheduler::Dispatch(success_t const& callback)
         }
     }
 
-    while (!_task_holder.IsEmpty())
+    while (TaskContainer task = _task_holder.PopExpired(_now))
     {
-        if (_task_holder.First()->_end > _now)
-        {
-            break;
-        }
-
         // Perfect forward the context to the handler
         // Use weak references to catch destruction before callbacks.
-        TaskContext context(_task_holder.Pop(), std::weak_ptr<TaskScheduler>(self_reference));
+        TaskContext context(std::move(task), std::weak_ptr<TaskScheduler>(self_reference));
 
         // Invoke the context
         context.Invoke();
@@ -119,71 +256,377 @@ void TaskScheduler::Dispatch(success_t const& callback)
     callback();
 }
 
-void TaskScheduler::TaskQueue::Push(TaskContainer&& task)
+#if WARHEAD_COMPILER == WARHEAD_COMPILER_MICROSOFT
+#include <intrin.h>
+#endif
+
+namespace
 {
-    container.insert(task);
+    // Index of the lowest set bit, mask must not be zero
+    inline uint32 LowestBit(uint64 mask)
+    {
+#if WARHEAD_COMPILER == WARHEAD_COMPILER_MICROSOFT
+        unsigned long index;
+        _BitScanForward64(&index, mask);
+        return uint32(index);
+#else
+        return uint32(__builtin_ctzll(mask));
+#endif
+    }
 }
 
-auto TaskScheduler::TaskQueue::Pop() -> TaskContainer
+TaskScheduler::TaskQueue::~TaskQueue()
 {
-    TaskContainer result = *container.begin();
-    container.erase(container.begin());
-    return result;
+    // Break self references of linked tasks
+    Clear();
 }
 
-auto TaskScheduler::TaskQueue::First() const -> TaskContainer const&
+void TaskScheduler::TaskQueue::Push(TaskContainer&& task)
 {
-    return *container.begin();
+    Task* const data = task.get();
+
+    if (data->_group)
+    {
+        data->_linkedGroup = data->_group;
+        AppendToGroup(_groups[*data->_group], data);
+    }
+
+    ++_size;
+    data->_sequence = ++_sequence;
+    data->_self = std::move(task);
+
+    uint64 const tick = GetTick(data->_end);
+    if (tick <= _currentTick)
+        PushReady(data);
+    else
+        Place(data, tick);
+}
+
+auto TaskScheduler::TaskQueue::PopExpired(timepoint_t const& now) -> TaskContainer
+{
+    Advance(GetTick(now));
+
+    while (!_ready.empty())
+    {
+        ReadyEntry& first = _ready.front();
+        Task* const task = first.Data.get();
+
+        // Entry of a task which was canceled or modified after it became ready
+        if (!IsValid(first))
+        {
+            std::pop_heap(_ready.begin(), _ready.end(), &ReadyLater);
+            _ready.pop_back();
+            continue;
+        }
+
+        // Same tick, but later than now
+        if (task->_end > now)
+            return {};
+
+        std::pop_heap(_ready.begin(), _ready.end(), &ReadyLater);
+        TaskContainer result = std::move(_ready.back().Data);
+        _ready.pop_back();
+
+        Unlink(task);
+        return result;
+    }
+
+    return {};
 }
 
 void TaskScheduler::TaskQueue::Clear()
 {
-    container.clear();
+    for (TaskContainer const& task : GetAllTasks())
+        Unlink(task.get());
+
+    _ready.clear();
+    _groups.clear();
 }
 
-void TaskScheduler::TaskQueue::RemoveIf(std::function<bool(TaskContainer const&)> const& filter)
+void TaskScheduler::TaskQueue::RemoveGroup(group_t const group)
 {
-    for (auto itr = container.begin(); itr != container.end();)
-        if (filter(*itr))
+    for (TaskContainer const& task : GetGroupTasks(group))
+        Unlink(task.get());
+
+    // Empty lists are kept for reuse by repeating tasks, until the group is canceled
+    _groups.erase(group);
+}
+
+void TaskScheduler::TaskQueue::ModifyGroup(group_t const group, std::function<void(Task&)> const& modify)
+{
+    ModifyTasks(GetGroupTasks(group), modify);
+}
+
+void TaskScheduler::TaskQueue::ModifyAll(std::function<void(Task&)> const& modify)
+{
+    ModifyTasks(GetAllTasks(), modify);
+}
+
+auto TaskScheduler::TaskQueue::GetGroupTasks(group_t const group) const -> std::vector<TaskContainer>
+{
+    std::vector<TaskContainer> tasks;
+
+    auto itr = _groups.find(group);
+    if (itr == _groups.end())
+        return tasks;
+
+    for (Task* task = itr->second.Head; task; task = task->_groupNext)
+        tasks.emplace_back(task->_self);
+
+    return tasks;
+}
+
+auto TaskScheduler::TaskQueue::GetAllTasks() const -> std::vector<TaskContainer>
+{
+    std::vector<TaskContainer> tasks;
+    tasks.reserve(_size);
+
+    for (auto const& level : _slots)
+        for (Slot const& slot : level)
+            for (SlotEntry const& entry : slot)
+                tasks.emplace_back(entry.Data->_self);
+
+    for (SlotEntry const& entry : _overflow)
+        tasks.emplace_back(entry.Data->_self);
+
+    for (ReadyEntry const& entry : _ready)
+        if (IsValid(entry))
+            tasks.emplace_back(entry.Data);
+
+    return tasks;
+}
+
+void TaskScheduler::TaskQueue::ModifyTasks(std::vector<TaskContainer>&& tasks, std::function<void(Task&)> const& modify)
+{
+    for (TaskContainer const& task : tasks)
+        Unlink(task.get());
+
+    // Keep the dispatch order of tasks with the same end
+    std::sort(tasks.begin(), tasks.end(), [](TaskContainer const& left, TaskContainer const& right)
+    {
+        if (left->_end != right->_end)
+            return left->_end < right->_end;
+
+        return left->_sequence < right->_sequence;
+    });
+
+    for (TaskContainer& task : tasks)
+    {
+        modify(*task);
+        Push(std::move(task));
+    }
+}
+
+void TaskScheduler::TaskQueue::UpdateGroup(Task& task)
+{
+    if (task._state == Task::State::None || task._linkedGroup == task._group)
+        return;
+
+    if (task._linkedGroup)
+        RemoveFromGroup(*task._linkedGroup, &task);
+
+    task._linkedGroup = task._group;
+
+    if (task._group)
+        AppendToGroup(_groups[*task._group], &task);
+}
+
+bool TaskScheduler::TaskQueue::IsEmpty() const
+{
+    return !_size;
+}
+
+uint64 TaskScheduler::TaskQueue::GetTick(timepoint_t const& time) const
+{
+    if (time <= _epoch)
+        return 0;
+
+    return uint64(std::chrono::duration_cast<std::chrono::milliseconds>(time - _epoch).count());
+}
+
+void TaskScheduler::TaskQueue::Advance(uint64 tick)
+{
+    while (_currentTick < tick)
+    {
+        // Find the nearest tick with an expiring slot (level 0) or a slot to cascade (upper levels)
+        uint32 level = 0;
+        uint64 next = 0;
+
+        for (; level < LevelsCount; ++level)
         {
-            itr = container.erase(itr);
+            uint32 const shift = level * SlotBits;
+            uint32 const digit = uint32(_currentTick >> shift) & (SlotsCount - 1);
+            uint64 const mask = digit + 1 < SlotsCount ? _occupied[level] & (~uint64(0) << (digit + 1)) : 0;
+
+            if (mask)
+            {
+                uint64 const block = _currentTick >> (shift + SlotBits) << (shift + SlotBits);
+                next = block + (uint64(LowestBit(mask)) << shift);
+                break;
+            }
         }
-        else
+
+        if (level == LevelsCount)
         {
-            ++itr;
+            if (_overflow.empty())
+            {
+                _currentTick = tick;
+                return;
+            }
+
+            uint32 const shift = LevelsCount * SlotBits;
+            next = ((_currentTick >> shift) + 1) << shift;
         }
-}
 
-void TaskScheduler::TaskQueue::ModifyIf(std::function<bool(TaskContainer const&)> const& filter)
-{
-    std::vector<TaskContainer> cache;
-    for (auto itr = container.begin(); itr != container.end();)
-        if (filter(*itr))
+        if (next > tick)
         {
-            cache.push_back(*itr);
-            itr = container.erase(itr);
+            _currentTick = tick;
+            return;
         }
+
+        _currentTick = next;
+
+        if (level == LevelsCount)
+            _cascade.swap(_overflow);
         else
         {
-            ++itr;
+            uint32 const slot = uint32(next >> (level * SlotBits)) & (SlotsCount - 1);
+            _cascade.swap(_slots[level][slot]);
+            _occupied[level] &= ~(uint64(1) << slot);
         }
 
-    container.insert(cache.begin(), cache.end());
+        // Expired tasks go to the ready heap, others down to the lower levels
+        for (SlotEntry const& entry : _cascade)
+        {
+            if (entry.Tick <= _currentTick)
+                PushReady(entry.Data);
+            else
+                Place(entry.Data, entry.Tick);
+        }
+
+        _cascade.clear();
+    }
 }
 
-bool TaskScheduler::TaskQueue::IsEmpty() const
+void TaskScheduler::TaskQueue::Place(Task* task, uint64 tick)
+{
+    // Level where the tick differs from the current tick only at this and lower levels
+    uint32 level = 0;
+    while (level < LevelsCount && (tick >> ((level + 1) * SlotBits)) != (_currentTick >> ((level + 1) * SlotBits)))
+        ++level;
+
+    Slot* target = &_overflow;
+
+    if (level == LevelsCount)
+        task->_state = Task::State::Overflow;
+    else
+    {
+        uint32 const slot = uint32(tick >> (level * SlotBits)) & (SlotsCount - 1);
+
+        task->_state = Task::State::Wheel;
+        task->_level = uint8(level);
+        task->_slot = uint8(slot);
+        target = &_slots[level][slot];
+        _occupied[level] |= uint64(1) << slot;
+    }
+
+    task->_index = uint32(target->size());
+    target->push_back({ task, tick });
+}
+
+void TaskScheduler::TaskQueue::PushReady(Task* task)
+{
+    task->_state = Task::State::Ready;
+    _ready.push_back({ task->_self, task->_end, task->_sequence });
+    std::push_heap(_ready.begin(), _ready.end(), &ReadyLater);
+}
+
+/*static*/ bool TaskScheduler::TaskQueue::ReadyLater(ReadyEntry const& left, ReadyEntry const& right)
+{
+    if (left.End != right.End)
+        return left.End > right.End;
+
+    return left.Sequence > right.Sequence;
+}
+
+/*static*/ bool TaskScheduler::TaskQueue::IsValid(ReadyEntry const& entry)
 {
-    return container.empty();
+    return entry.Data->_state == Task::State::Ready && entry.Data->_sequence == entry.Sequence;
 }
 
-TaskContext& TaskContext::Dispatch(std::function<TaskScheduler&(TaskScheduler&)> const& apply)
+void TaskScheduler::TaskQueue::Unlink(Task* task)
 {
-    if (auto const owner = _owner.lock())
+    switch (task->_state)
     {
-        apply(*owner);
+        case Task::State::None:
+            return;
+        case Task::State::Wheel:
+        {
+            Slot& slot = _slots[task->_level][task->_slot];
+            Remove(slot, task);
+
+            if (slot.empty())
+                _occupied[task->_level] &= ~(uint64(1) << task->_slot);
+            break;
+        }
+        case Task::State::Overflow:
+            Remove(_overflow, task);
+            break;
+        case Task::State::Ready:
+            // Heap entry is dropped lazily, it keeps the task alive until then
+            break;
     }
 
-    return *this;
+    if (task->_linkedGroup)
+    {
+        RemoveFromGroup(*task->_linkedGroup, task);
+        task->_linkedGroup.reset();
+    }
+
+    task->_state = Task::State::None;
+    --_size;
+
+    // Can destroy the task, must be the last access
+    task->_self.reset();
+}
+
+/*static*/ void TaskScheduler::TaskQueue::Remove(Slot& slot, Task* task)
+{
+    // Order inside a slot doesn't matter, the last entry takes the place of the removed one
+    SlotEntry& entry = slot[task->_index];
+    entry = slot.back();
+    entry.Data->_index = task->_index;
+    slot.pop_back();
+}
+
+/*static*/ void TaskScheduler::TaskQueue::AppendToGroup(TaskList& list, Task* task)
+{
+    task->_groupPrev = list.Tail;
+    task->_groupNext = nullptr;
+
+    if (list.Tail)
+        list.Tail->_groupNext = task;
+    else
+        list.Head = task;
+
+    list.Tail = task;
+}
+
+void TaskScheduler::TaskQueue::RemoveFromGroup(group_t const group, Task* task)
+{
+    TaskList& list = _groups.find(group)->second;
+
+    if (task->_groupPrev)
+        task->_groupPrev->_groupNext = task->_groupNext;
+    else
+        list.Head = task->_groupNext;
+
+    if (task->_groupNext)
+        task->_groupNext->_groupPrev = task->_groupPrev;
+    else
+        list.Tail = task->_groupPrev;
+
+    task->_groupPrev = task->_groupNext = nullptr;
 }
 
 bool TaskContext::IsExpired() const
@@ -199,13 +642,26 @@ bool TaskContext::IsInGroup(TaskScheduler::group_t const group) const
 TaskContext& TaskContext::SetGroup(TaskScheduler::group_t const group)
 {
     _task->_group = group;
-    return *this;
+    return UpdateGroup();
 }
 
 TaskContext& TaskContext::ClearGroup()
 {
     _task->_group = std::nullopt;
-    return *this;
+    return UpdateGroup();
+}
+
+TaskContext& TaskContext::UpdateGroup()
+{
+    // Task is queued again if it was repeated already
+    if (_task->_state == TaskScheduler::Task::State::None)
+        return *this;
+
+    return Dispatch([task = _task](TaskScheduler& scheduler) -> TaskScheduler&
+    {
+        scheduler._task_holder.UpdateGroup(*task);
+        return scheduler;
+    });
 }
 
 TaskScheduler::repeated_t TaskContext::GetRepeatCounter() const
@@ -213,9 +669,12 @@ TaskScheduler::repeated_t TaskContext::GetRepeatCounter() const
     return _task->_repeated;
 }
 
-TaskContext& TaskContext::Async(std::function<void()> const& callable)
+TaskContext& TaskContext::Async(Warhead::MoveOnlyFunction<void()> callable)
 {
-    return Dispatch(std::bind(&TaskScheduler::Async, std::placeholders::_1, callable));
+    return Dispatch([&callable](TaskScheduler& scheduler) -> TaskScheduler&
+    {
+        return scheduler.Async(std::move(callable));
+    });
 }
 
 TaskContext& TaskContext::CancelAll()
@@ -237,7 +696,7 @@ void TaskContext::AssertOnConsumed() const
 {
     // This was adapted to TC to prevent static analysis tools from complaining.
     // If you encounter this assertion check if you repeat a TaskContext more then 1 time!
-    ASSERT(!(*_consumed) && "Bad task logic, task context was consumed already!");
+    ASSERT(_task && _task->_consumedInvocation < _invocation && "Bad task logic, task context was consumed already!");
 }
 
 void TaskContext::Invoke()
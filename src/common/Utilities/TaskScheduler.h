@@ -18,23 +18,26 @@
 #ifndef _TASK_SCHEDULER_H_
 #define _TASK_SCHEDULER_H_
 
+#include "MPSCQueue.h"
+#include "MoveOnlyFunction.h"
 #include "Util.h"
 #include <algorithm>
+#include <array>
 #include <chrono>
 #include <functional>
 #include <memory>
 #include <optional>
 #include <queue>
-#include <set>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 class TaskContext;
 
-/// The TaskScheduler class provides the ability to schedule std::function's in the near future.
+/// The TaskScheduler class provides the ability to schedule callables in the near future.
 /// Use TaskScheduler::Update to update the scheduler.
 /// Popular methods are:
-/// * Schedule (Schedules a std::function which will be executed in the near future).
+/// * Schedule (Schedules a callable which will be executed in the near future).
 /// * Schedules an asynchronous function which will be executed at the next update tick.
 /// * Cancel, Delay & Reschedule (Methods to manipulate already scheduled tasks).
 /// Tasks are organized in groups (uint), multiple tasks can have the same group id,
@@ -58,16 +61,31 @@ class WH_COMMON_API TaskScheduler
     // Task repeated type
     typedef uint32 repeated_t;
     // Task handle type
-    typedef std::function<void(TaskContext)> task_handler_t;
+    typedef Warhead::MoveOnlyFunction<void(TaskContext)> task_handler_t;
     // Predicate type
-    typedef std::function<bool()> predicate_t;
+    typedef Warhead::MoveOnlyFunction<bool()> predicate_t;
     // Success handle type
-    typedef std::function<void()> success_t;
+    typedef Warhead::MoveOnlyFunction<void()> success_t;
+
+    class Task;
+    class TaskQueue;
+
+    typedef std::shared_ptr<Task> TaskContainer;
 
     class Task
     {
         friend class TaskContext;
         friend class TaskScheduler;
+        friend class TaskQueue;
+
+        // Where the task is linked in the TaskQueue
+        enum class State : uint8
+        {
+            None,
+            Wheel,
+            Overflow,
+            Ready
+        };
 
         timepoint_t _end;
         duration_t _duration;
@@ -75,22 +93,37 @@ class WH_COMMON_API TaskScheduler
         repeated_t _repeated;
         task_handler_t _task;
 
+        // Count of TaskContexts created for the task and the last one which consumed it
+        uint32 _invocation{ 0 };
+        uint32 _consumedInvocation{ 0 };
+
+        // TaskQueue links, the queue owns the task through _self while it is queued
+        TaskContainer _self;
+        Task* _groupPrev{ nullptr };
+        Task* _groupNext{ nullptr };
+        std::optional<group_t> _linkedGroup;
+        uint64 _sequence{ 0 }; // push order, tasks with the same end are dispatched in this order
+        uint32 _index{ 0 }; // position in the slot or overflow entries
+        State _state{ State::None };
+        uint8 _level{ 0 };
+        uint8 _slot{ 0 };
+
     public:
         // All Argument construct
         Task(timepoint_t const& end, duration_t const& duration, std::optional<group_t> const& group,
-             repeated_t const repeated, task_handler_t const& task)
-            : _end(end), _duration(duration), _group(group), _repeated(repeated), _task(task) { }
+             repeated_t const repeated, task_handler_t&& task)
+            : _end(end), _duration(duration), _group(group), _repeated(repeated), _task(std::move(task)) { }
 
         // Minimal Argument construct
-        Task(timepoint_t const& end, duration_t const& duration, task_handler_t const& task)
-            : _end(end), _duration(duration), _group(std::nullopt), _repeated(0), _task(task) { }
+        Task(timepoint_t const& end, duration_t const& duration, task_handler_t&& task)
+            : _end(end), _duration(duration), _group(std::nullopt), _repeated(0), _task(std::move(task)) { }
 
         // Copy construct
         Task(Task const&) = delete;
         // Move construct
         Task(Task&&) = delete;
         // Copy Assign
-        Task& operator= (Task const&) = default;
+        Task& operator= (Task const&) = delete;
         // Move Assign
         Task& operator= (Task&& right) = delete;
 
@@ -118,37 +151,88 @@ class WH_COMMON_API TaskScheduler
         }
     };
 
-    typedef std::shared_ptr<Task> TaskContainer;
-
     /// Container which provides Task order, insert and reschedule operations.
-    struct Compare
+    /// Hierarchical timing wheel with 1ms ticks: schedule and cancel are O(1),
+    /// expired slots are moved at once to the ready heap where tasks are ordered by its exact end.
+    /// Slots are arrays of task pointers with their tick, a cascade reads them in order instead of following list links.
+    /// Tasks are also linked in a list per group, so group operations only touch tasks of the group.
+    class TaskQueue
     {
-        bool operator() (TaskContainer const& left, TaskContainer const& right) const
+        static constexpr uint32 SlotBits = 6;
+        static constexpr uint32 SlotsCount = 1 << SlotBits;
+        static constexpr uint32 LevelsCount = 6; // 64^6 ms ~ 2 years, farther tasks wait in the overflow list
+
+        struct SlotEntry
         {
-            return (*left.get()) < (*right.get());
+            Task* Data;
+            uint64 Tick;
         };
-    };
 
-    class TaskQueue
-    {
-        std::multiset<TaskContainer, Compare> container;
+        typedef std::vector<SlotEntry> Slot;
+
+        struct TaskList
+        {
+            Task* Head{ nullptr };
+            Task* Tail{ nullptr };
+        };
+
+        // End is copied, stale entries must keep their place in the heap when the task changes
+        struct ReadyEntry
+        {
+            TaskContainer Data;
+            timepoint_t End;
+            uint64 Sequence;
+        };
+
+        timepoint_t _epoch;
+        uint64 _currentTick{ 0 };
+        std::array<std::array<Slot, SlotsCount>, LevelsCount> _slots;
+        std::array<uint64, LevelsCount> _occupied{};
+        Slot _overflow;
+        Slot _cascade; // slot taken out by Advance, kept for its capacity
+        std::vector<ReadyEntry> _ready;
+        uint64 _sequence{ 0 };
+        std::unordered_map<group_t, TaskList> _groups;
+        std::size_t _size{ 0 };
 
     public:
+        explicit TaskQueue(timepoint_t const& epoch) : _epoch(epoch) { }
+        ~TaskQueue();
+
         // Pushes the task in the container
         void Push(TaskContainer&& task);
 
-        /// Pops the task out of the container
-        TaskContainer Pop();
-
-        TaskContainer const& First() const;
+        /// Pops the first task which ends not later than now, empty if there is none
+        TaskContainer PopExpired(timepoint_t const& now);
 
         void Clear();
 
-        void RemoveIf(std::function<bool(TaskContainer const&)> const& filter);
+        void RemoveGroup(group_t const group);
+
+        void ModifyGroup(group_t const group, std::function<void(Task&)> const& modify);
+
+        void ModifyAll(std::function<void(Task&)> const& modify);
 
-        void ModifyIf(std::function<bool(TaskContainer const&)> const& filter);
+        /// Moves a queued task to the list of its new group
+        void UpdateGroup(Task& task);
 
         bool IsEmpty() const;
+
+    private:
+        uint64 GetTick(timepoint_t const& time) const;
+        void Advance(uint64 tick);
+        void Place(Task* task, uint64 tick);
+        void PushReady(Task* task);
+        void Unlink(Task* task);
+        std::vector<TaskContainer> GetGroupTasks(group_t const group) const;
+        std::vector<TaskContainer> GetAllTasks() const;
+        void ModifyTasks(std::vector<TaskContainer>&& tasks, std::function<void(Task&)> const& modify);
+        void RemoveFromGroup(group_t const group, Task* task);
+
+        static bool ReadyLater(ReadyEntry const& left, ReadyEntry const& right);
+        static bool IsValid(ReadyEntry const& entry);
+        static void Remove(Slot& slot, Task* task);
+        static void AppendToGroup(TaskList& list, Task* task);
     };
 
     /// Contains a self reference to track if this object was deleted or not.
@@ -160,12 +244,25 @@ class WH_COMMON_API TaskScheduler
     /// The Task Queue which contains all task objects.
     TaskQueue _task_holder;
 
-    typedef std::queue<std::function<void()>> AsyncHolder;
+    typedef std::queue<Warhead::MoveOnlyFunction<void()>> AsyncHolder;
 
     /// Contains all asynchronous tasks which will be invoked at
     /// the next update tick.
     AsyncHolder _asyncHolder;
 
+    /// Task or async callable posted from another thread, applied at the next update tick.
+    struct InboxEntry
+    {
+        duration_t Time{ 0 };
+        std::optional<group_t> Group;
+        task_handler_t Task;
+        Warhead::MoveOnlyFunction<void()> Async; // set for AsyncFromAnyThread
+        std::atomic<InboxEntry*> Link{ nullptr };
+    };
+
+    /// Lock free inbox of other threads, drained only by the owner thread in Update.
+    MPSCQueue<InboxEntry, &InboxEntry::Link> _inbox;
+
     predicate_t _predicate;
 
     static bool EmptyValidator()
@@ -179,10 +276,10 @@ class WH_COMMON_API TaskScheduler
 
 public:
     TaskScheduler()
-        : self_reference(this, [](TaskScheduler const*) { }), _now(clock_t::now()), _predicate(EmptyValidator) { }
+        : self_reference(this, [](TaskScheduler const*) { }), _now(clock_t::now()), _task_holder(_now), _predicate(EmptyValidator) { }
 
     template<typename P> TaskScheduler(P&& predicate)
-        : self_reference(this, [](TaskScheduler const*) { }), _now(clock_t::now()), _predicate(std::forward<P>(predicate)) { }
+        : self_reference(this, [](TaskScheduler const*) { }), _now(clock_t::now()), _task_holder(_now), _predicate(std::forward<P>(predicate)) { }
 
     TaskScheduler(TaskScheduler const&) = delete;
     TaskScheduler(TaskScheduler&&) = delete;
@@ -202,17 +299,17 @@ public:
 
     /// Update the scheduler to the current time.
     /// Calls the optional callback on successfully finish.
-    TaskScheduler& Update(success_t const& callback = EmptyCallback);
+    TaskScheduler& Update(success_t const& callback = success_t(EmptyCallback));
 
     /// Update the scheduler with a difftime in ms.
     /// Calls the optional callback on successfully finish.
-    TaskScheduler& Update(size_t const milliseconds, success_t const& callback = EmptyCallback);
+    TaskScheduler& Update(size_t const milliseconds, success_t const& callback = success_t(EmptyCallback));
 
     /// Update the scheduler with a difftime.
     /// Calls the optional callback on successfully finish.
     template<class _Rep, class _Period>
     TaskScheduler& Update(std::chrono::duration<_Rep, _Period> const& difftime,
-                          success_t const& callback = EmptyCallback)
+                          success_t const& callback = success_t(EmptyCallback))
     {
         _now += difftime;
         Dispatch(callback);
@@ -221,33 +318,33 @@ public:
 
     /// Schedule an callable function that is executed at the next update tick.
     /// Its safe to modify the TaskScheduler from within the callable.
-    TaskScheduler& Async(std::function<void()> const& callable);
+    TaskScheduler& Async(Warhead::MoveOnlyFunction<void()> callable);
 
     /// Schedule an event with a fixed rate.
     /// Never call this from within a task context! Use TaskContext::Schedule instead!
     template<class _Rep, class _Period>
     TaskScheduler& Schedule(std::chrono::duration<_Rep, _Period> const& time,
-                            task_handler_t const& task)
+                            task_handler_t task)
     {
-        return ScheduleAt(_now, time, task);
+        return ScheduleAt(_now, time, std::move(task));
     }
 
     /// Schedule an event with a fixed rate.
     /// Never call this from within a task context! Use TaskContext::Schedule instead!
     template<class _Rep, class _Period>
     TaskScheduler& Schedule(std::chrono::duration<_Rep, _Period> const& time,
-                            group_t const group, task_handler_t const& task)
+                            group_t const group, task_handler_t task)
     {
-        return ScheduleAt(_now, time, group, task);
+        return ScheduleAt(_now, time, group, std::move(task));
     }
 
     /// Schedule an event with a randomized rate between min and max rate.
     /// Never call this from within a task context! Use TaskContext::Schedule instead!
     template<class _RepLeft, class _PeriodLeft, class _RepRight, class _PeriodRight>
     TaskScheduler& Schedule(std::chrono::duration<_RepLeft, _PeriodLeft> const& min,
-                            std::chrono::duration<_RepRight, _PeriodRight> const& max, task_handler_t const& task)
+                            std::chrono::duration<_RepRight, _PeriodRight> const& max, task_handler_t task)
     {
-        return Schedule(RandomDurationBetween(min, max), task);
+        return Schedule(RandomDurationBetween(min, max), std::move(task));
     }
 
     /// Schedule an event with a fixed rate.
@@ -255,9 +352,31 @@ public:
     template<class _RepLeft, class _PeriodLeft, class _RepRight, class _PeriodRight>
     TaskScheduler& Schedule(std::chrono::duration<_RepLeft, _PeriodLeft> const& min,
                             std::chrono::duration<_RepRight, _PeriodRight> const& max, group_t const group,
-                            task_handler_t const& task)
+                            task_handler_t task)
+    {
+        return Schedule(RandomDurationBetween(min, max), group, std::move(task));
+    }
+
+    /// Schedule a callable function that is executed at the next update tick.
+    /// Thread safe, can be called from any thread while the owner thread updates the scheduler.
+    TaskScheduler& AsyncFromAnyThread(Warhead::MoveOnlyFunction<void()> callable);
+
+    /// Schedule an event with a fixed rate, counted from the update tick which receives it.
+    /// Thread safe, can be called from any thread while the owner thread updates the scheduler.
+    template<class _Rep, class _Period>
+    TaskScheduler& ScheduleFromAnyThread(std::chrono::duration<_Rep, _Period> const& time,
+                                         task_handler_t task)
+    {
+        return PostToInbox(std::chrono::duration_cast<duration_t>(time), std::nullopt, std::move(task));
+    }
+
+    /// Schedule an event with a fixed rate, counted from the update tick which receives it.
+    /// Thread safe, can be called from any thread while the owner thread updates the scheduler.
+    template<class _Rep, class _Period>
+    TaskScheduler& ScheduleFromAnyThread(std::chrono::duration<_Rep, _Period> const& time,
+                                         group_t const group, task_handler_t task)
     {
-        return Schedule(RandomDurationBetween(min, max), group, task);
+        return PostToInbox(std::chrono::duration_cast<duration_t>(time), group, std::move(task));
     }
 
     /// Cancels all tasks.
@@ -276,10 +395,9 @@ public:
     template<class _Rep, class _Period>
     TaskScheduler& DelayAll(std::chrono::duration<_Rep, _Period> const& duration)
     {
-        _task_holder.ModifyIf([&duration](TaskContainer const & task) -> bool
+        _task_holder.ModifyAll([&duration](Task& task)
         {
-            task->_end += duration;
-            return true;
+            task._end += duration;
         });
         return *this;
     }
@@ -296,17 +414,9 @@ public:
     template<class _Rep, class _Period>
     TaskScheduler& DelayGroup(group_t const group, std::chrono::duration<_Rep, _Period> const& duration)
     {
-        _task_holder.ModifyIf([&duration, group](TaskContainer const & task) -> bool
+        _task_holder.ModifyGroup(group, [&duration](Task& task)
         {
-            if (task->IsInGroup(group))
-            {
-                task->_end += duration;
-                return true;
-            }
-            else
-            {
-                return false;
-            }
+            task._end += duration;
         });
         return *this;
     }
@@ -325,10 +435,9 @@ public:
     TaskScheduler& RescheduleAll(std::chrono::duration<_Rep, _Period> const& duration)
     {
         auto const end = _now + duration;
-        _task_holder.ModifyIf([end](TaskContainer const & task) -> bool
+        _task_holder.ModifyAll([end](Task& task)
         {
-            task->_end = end;
-            return true;
+            task._end = end;
         });
         return *this;
     }
@@ -346,17 +455,9 @@ public:
     TaskScheduler& RescheduleGroup(group_t const group, std::chrono::duration<_Rep, _Period> const& duration)
     {
         auto const end = _now + duration;
-        _task_holder.ModifyIf([end, group](TaskContainer const & task) -> bool
+        _task_holder.ModifyGroup(group, [end](Task& task)
         {
-            if (task->IsInGroup(group))
-            {
-                task->_end = end;
-                return true;
-            }
-            else
-            {
-                return false;
-            }
+            task._end = end;
         });
         return *this;
     }
@@ -374,11 +475,14 @@ private:
     /// Insert a new task to the enqueued tasks.
     TaskScheduler& InsertTask(TaskContainer task);
 
+    /// Creates the task in pooled storage, task and its shared_ptr control block are one allocation.
+    static TaskContainer MakeTask(timepoint_t const& end, duration_t const& duration, std::optional<group_t> const& group, task_handler_t&& task);
+
     template<class _Rep, class _Period>
     TaskScheduler& ScheduleAt(timepoint_t const& end,
-                              std::chrono::duration<_Rep, _Period> const& time, task_handler_t const& task)
+                              std::chrono::duration<_Rep, _Period> const& time, task_handler_t task)
     {
-        return InsertTask(TaskContainer(new Task(end + time, time, task)));
+        return InsertTask(MakeTask(end + time, time, std::nullopt, std::move(task)));
     }
 
     /// Schedule an event with a fixed rate.
@@ -386,10 +490,9 @@ private:
     template<class _Rep, class _Period>
     TaskScheduler& ScheduleAt(timepoint_t const& end,
                               std::chrono::duration<_Rep, _Period> const& time,
-                              group_t const group, task_handler_t const& task)
+                              group_t const group, task_handler_t task)
     {
-        static repeated_t const DEFAULT_REPEATED = 0;
-        return InsertTask(TaskContainer(new Task(end + time, time, group, DEFAULT_REPEATED, task)));
+        return InsertTask(MakeTask(end + time, time, group, std::move(task)));
     }
 
     // Returns a random duration between min and max
@@ -406,6 +509,12 @@ private:
 
     /// Dispatch remaining tasks
     void Dispatch(success_t const& callback);
+
+    /// Enqueues a task from any thread
+    TaskScheduler& PostToInbox(duration_t const& time, std::optional<group_t> const& group, task_handler_t&& task);
+
+    /// Applies tasks posted from other threads, owner thread only
+    void ProcessInbox();
 };
 
 class WH_COMMON_API TaskContext
@@ -418,35 +527,45 @@ class WH_COMMON_API TaskContext
     /// Owner
     std::weak_ptr<TaskScheduler> _owner;
 
-    /// Marks the task as consumed
-    std::shared_ptr<bool> _consumed;
+    /// Invocation of the task this context belongs to, consumed if the task is consumed up to it.
+    /// Copies of the context share the state through the task, no allocation per invocation.
+    uint32 _invocation;
 
     /// Dispatches an action safe on the TaskScheduler
-    TaskContext& Dispatch(std::function<TaskScheduler&(TaskScheduler&)> const& apply);
+    template<typename Apply>
+    TaskContext& Dispatch(Apply&& apply)
+    {
+        if (auto const owner = _owner.lock())
+        {
+            apply(*owner);
+        }
+
+        return *this;
+    }
 
 public:
     // Empty constructor
     TaskContext()
-        : _task(), _owner(), _consumed(std::make_shared<bool>(true)) { }
+        : _task(), _owner(), _invocation(0) { }
 
     // Construct from task and owner
     explicit TaskContext(TaskScheduler::TaskContainer&& task, std::weak_ptr<TaskScheduler>&& owner)
-        : _task(task), _owner(owner), _consumed(std::make_shared<bool>(false)) { }
+        : _task(std::move(task)), _owner(std::move(owner)), _invocation(++_task->_invocation) { }
 
     // Copy construct
     TaskContext(TaskContext const& right)
-        : _task(right._task), _owner(right._owner), _consumed(right._consumed) { }
+        : _task(right._task), _owner(right._owner), _invocation(right._invocation) { }
 
     // Move construct
     TaskContext(TaskContext&& right)
-        : _task(std::move(right._task)), _owner(std::move(right._owner)), _consumed(std::move(right._consumed)) { }
+        : _task(std::move(right._task)), _owner(std::move(right._owner)), _invocation(right._invocation) { }
 
     // Copy assign
     TaskContext& operator= (TaskContext const& right)
     {
         _task = right._task;
         _owner = right._owner;
-        _consumed = right._consumed;
+        _invocation = right._invocation;
         return *this;
     }
 
@@ -455,7 +574,7 @@ public:
     {
         _task = std::move(right._task);
         _owner = std::move(right._owner);
-        _consumed = std::move(right._consumed);
+        _invocation = right._invocation;
         return *this;
     }
 
@@ -487,7 +606,7 @@ public:
         _task->_duration = duration;
         _task->_end += duration;
         _task->_repeated += 1;
-        (*_consumed) = true;
+        _task->_consumedInvocation = _invocation;
         return Dispatch(std::bind(&TaskScheduler::InsertTask, std::placeholders::_1, _task));
     }
 
@@ -512,7 +631,7 @@ public:
 
     /// Schedule a callable function that is executed at the next update tick from within the context.
     /// Its safe to modify the TaskScheduler from within the callable.
-    TaskContext& Async(std::function<void()> const& callable);
+    TaskContext& Async(Warhead::MoveOnlyFunction<void()> callable);
 
     /// Schedule an event with a fixed rate from within the context.
     /// Its possible that the new event is executed immediately!
@@ -520,12 +639,12 @@ public:
     /// which will be called at the next update tick.
     template<class _Rep, class _Period>
     TaskContext& Schedule(std::chrono::duration<_Rep, _Period> const& time,
-                          TaskScheduler::task_handler_t const& task)
+                          TaskScheduler::task_handler_t task)
     {
         auto const end = _task->_end;
-        return Dispatch([end, time, task](TaskScheduler & scheduler) -> TaskScheduler &
+        return Dispatch([end, time, &task](TaskScheduler & scheduler) -> TaskScheduler &
         {
-            return scheduler.ScheduleAt<_Rep, _Period>(end, time, task);
+            return scheduler.ScheduleAt<_Rep, _Period>(end, time, std::move(task));
         });
     }
 
@@ -535,12 +654,12 @@ public:
     /// which will be called at the next update tick.
     template<class _Rep, class _Period>
     TaskContext& Schedule(std::chrono::duration<_Rep, _Period> const& time,
-                          TaskScheduler::group_t const group, TaskScheduler::task_handler_t const& task)
+                          TaskScheduler::group_t const group, TaskScheduler::task_handler_t task)
     {
         auto const end = _task->_end;
-        return Dispatch([end, time, group, task](TaskScheduler & scheduler) -> TaskScheduler &
+        return Dispatch([end, time, group, &task](TaskScheduler & scheduler) -> TaskScheduler &
         {
-            return scheduler.ScheduleAt<_Rep, _Period>(end, time, group, task);
+            return scheduler.ScheduleAt<_Rep, _Period>(end, time, group, std::move(task));
         });
     }
 
@@ -550,9 +669,9 @@ public:
     /// which will be called at the next update tick.
     template<class _RepLeft, class _PeriodLeft, class _RepRight, class _PeriodRight>
     TaskContext& Schedule(std::chrono::duration<_RepLeft, _PeriodLeft> const& min,
-                          std::chrono::duration<_RepRight, _PeriodRight> const& max, TaskScheduler::task_handler_t const& task)
+                          std::chrono::duration<_RepRight, _PeriodRight> const& max, TaskScheduler::task_handler_t task)
     {
-        return Schedule(TaskScheduler::RandomDurationBetween(min, max), task);
+        return Schedule(TaskScheduler::RandomDurationBetween(min, max), std::move(task));
     }
 
     /// Schedule an event with a randomized rate between min and max rate from within the context.
@@ -562,9 +681,9 @@ public:
     template<class _RepLeft, class _PeriodLeft, class _RepRight, class _PeriodRight>
     TaskContext& Schedule(std::chrono::duration<_RepLeft, _PeriodLeft> const& min,
                           std::chrono::duration<_RepRight, _PeriodRight> const& max, TaskScheduler::group_t const group,
-                          TaskScheduler::task_handler_t const& task)
+                          TaskScheduler::task_handler_t task)
     {
-        return Schedule(TaskScheduler::RandomDurationBetween(min, max), group, task);
+        return Schedule(TaskScheduler::RandomDurationBetween(min, max), group, std::move(task));
     }
 
     /// Cancels all tasks from within the context.
@@ -643,6 +762,9 @@ private:
     /// Asserts if the task was consumed already.
     void AssertOnConsumed() const;
 
+    /// Relinks the task in the group lists if it is queued.
+    TaskContext& UpdateGroup();
+
     /// Invokes the associated hook of the task.
     void Invoke();
 };
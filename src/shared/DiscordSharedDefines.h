@@ -20,6 +20,62 @@
 
 #include "Define.h"
 
+/*
+ * Messages
+ *
+ * CLIENT_SEND_MESSAGE         - int64 channel id, string text
+ * CLIENT_SEND_MESSAGE_EMBED   - int64 channel id, uint8 embeds count, embed data for each embed
+ *
+ * Session resume
+ *
+ * SERVER_SEND_AUTH_RESPONSE   - uint8 code, on success optionally followed by string token and uint32 resume window in seconds
+ * CLIENT_RESUME_SESSION       - string token, uint64 last acknowledged sequence
+ * SERVER_SEND_RESUME_RESPONSE - uint8 code, uint64 received sequence
+ * SERVER_SEND_PONG            - int64 ping time, optionally followed by uint64 received sequence
+ *
+ * Every packet sent by the client after auth (all opcodes except auth, resume and ping)
+ * takes the next sequence number of the session, starting with 1. The client pings every
+ * Discord.Server.PingInterval seconds, the pong acknowledges what the server has received.
+ * After an accepted resume the client sends everything above the received sequence again,
+ * then continues with new packets. Nothing is sent again after a full auth.
+ */
+
+// Discord limits for one message
+constexpr auto DISCORD_MAX_MESSAGE_LENGTH = 2000;
+constexpr auto DISCORD_MAX_EMBEDS_COUNT = 10;
+
+// Discord limits for one embed, in characters
+constexpr auto DISCORD_EMBED_MAX_TITLE_LENGTH = 256;
+constexpr auto DISCORD_EMBED_MAX_DESCRIPTION_LENGTH = 4096;
+constexpr auto DISCORD_EMBED_MAX_FIELDS_COUNT = 25;
+constexpr auto DISCORD_EMBED_MAX_FIELD_NAME_LENGTH = 256;
+constexpr auto DISCORD_EMBED_MAX_FIELD_VALUE_LENGTH = 1024;
+constexpr auto DISCORD_EMBED_MAX_FOOTER_LENGTH = 2048;
+constexpr auto DISCORD_EMBED_MAX_AUTHOR_LENGTH = 256;
+constexpr auto DISCORD_EMBED_MAX_TOTAL_LENGTH = 6000;
+
+/*
+ * Embed data is a list of tagged values, ended with DiscordEmbedTag::End.
+ * Strings are null terminated, like ByteBuffer writes them.
+ */
+enum class DiscordEmbedTag : uint8
+{
+    End,
+    Title,          // string
+    Description,    // string
+    Url,            // string
+    Color,          // uint32 rgb
+    Timestamp,      // int64 unix time in seconds
+    FooterText,     // string
+    FooterIcon,     // string url
+    AuthorName,     // string
+    AuthorUrl,      // string url
+    AuthorIcon,     // string url
+    Thumbnail,      // string url
+    Image,          // string url
+    Field           // uint8 inline, string name, string value
+};
+
 // EnumUtils: DESCRIBE THIS
 enum DiscordCode : uint16
 {
@@ -32,6 +88,9 @@ enum DiscordCode : uint16
     SERVER_SEND_AUTH_RESPONSE,
     SERVER_SEND_PONG,
 
+    CLIENT_RESUME_SESSION,
+    SERVER_SEND_RESUME_RESPONSE,
+
     NUM_MSG_TYPES
 };
 
@@ -52,7 +111,8 @@ enum class DiscordAuthResponseCodes : uint8
     BannedIP,
     BannedPermanentlyAccount,
     BannedPermanentlyIP,    
-    ServerOffline
+    ServerOffline,
+    SessionExpired
 };
 
 // EnumUtils: DESCRIBE THIS
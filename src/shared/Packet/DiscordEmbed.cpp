@@ -0,0 +1,326 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DiscordEmbed.h"
+#include "StringFormat.h"
+#include <cstring>
+#include <utf8.h>
+
+namespace
+{
+    inline std::size_t GetLength(std::string_view text)
+    {
+        return utf8::unchecked::distance(text.begin(), text.end());
+    }
+
+    // tag + string + null terminator
+    inline std::size_t GetStringSize(std::string const& value)
+    {
+        return value.empty() ? 0 : sizeof(DiscordEmbedTag) + value.size() + 1;
+    }
+
+    inline void WriteString(ByteBuffer& buffer, DiscordEmbedTag tag, std::string const& value)
+    {
+        if (value.empty())
+            return;
+
+        buffer << uint8(tag);
+        buffer << value;
+    }
+}
+
+DiscordEmbedException::DiscordEmbedException(std::string_view error)
+{
+    message().assign(Warhead::StringFormat("Invalid discord embed: {}", error));
+}
+
+DiscordEmbed& DiscordEmbed::SetTitle(std::string_view title)
+{
+    _title = std::string(title);
+    return *this;
+}
+
+DiscordEmbed& DiscordEmbed::SetDescription(std::string_view description)
+{
+    _description = std::string(description);
+    return *this;
+}
+
+DiscordEmbed& DiscordEmbed::SetUrl(std::string_view url)
+{
+    _url = std::string(url);
+    return *this;
+}
+
+DiscordEmbed& DiscordEmbed::SetColor(uint32 color)
+{
+    _color = color & 0xFFFFFF;
+    return *this;
+}
+
+DiscordEmbed& DiscordEmbed::SetTimestamp(SystemTimePoint time)
+{
+    return SetTimestamp(std::chrono::duration_cast<Seconds>(time.time_since_epoch()));
+}
+
+DiscordEmbed& DiscordEmbed::SetTimestamp(Seconds unixTime)
+{
+    _timestamp = unixTime.count();
+    return *this;
+}
+
+DiscordEmbed& DiscordEmbed::SetFooter(std::string_view text, std::string_view iconUrl /*= {}*/)
+{
+    _footerText = std::string(text);
+    _footerIcon = std::string(iconUrl);
+    return *this;
+}
+
+DiscordEmbed& DiscordEmbed::SetAuthor(std::string_view name, std::string_view url /*= {}*/, std::string_view iconUrl /*= {}*/)
+{
+    _authorName = std::string(name);
+    _authorUrl = std::string(url);
+    _authorIcon = std::string(iconUrl);
+    return *this;
+}
+
+DiscordEmbed& DiscordEmbed::SetThumbnail(std::string_view url)
+{
+    _thumbnail = std::string(url);
+    return *this;
+}
+
+DiscordEmbed& DiscordEmbed::SetImage(std::string_view url)
+{
+    _image = std::string(url);
+    return *this;
+}
+
+DiscordEmbed& DiscordEmbed::AddField(std::string_view name, std::string_view value, bool isInline /*= false*/)
+{
+    _fields.emplace_back(Field{ std::string(name), std::string(value), isInline });
+    return *this;
+}
+
+std::string DiscordEmbed::Validate() const
+{
+    if (!utf8::is_valid(_title.begin(), _title.end()) || !utf8::is_valid(_description.begin(), _description.end()) ||
+        !utf8::is_valid(_footerText.begin(), _footerText.end()) || !utf8::is_valid(_authorName.begin(), _authorName.end()))
+        return "text is not valid utf8";
+
+    std::size_t const titleLength = GetLength(_title);
+    std::size_t const descriptionLength = GetLength(_description);
+    std::size_t const footerLength = GetLength(_footerText);
+    std::size_t const authorLength = GetLength(_authorName);
+
+    if (titleLength > DISCORD_EMBED_MAX_TITLE_LENGTH)
+        return Warhead::StringFormat("title length {} > {}", titleLength, DISCORD_EMBED_MAX_TITLE_LENGTH);
+
+    if (descriptionLength > DISCORD_EMBED_MAX_DESCRIPTION_LENGTH)
+        return Warhead::StringFormat("description length {} > {}", descriptionLength, DISCORD_EMBED_MAX_DESCRIPTION_LENGTH);
+
+    if (footerLength > DISCORD_EMBED_MAX_FOOTER_LENGTH)
+        return Warhead::StringFormat("footer length {} > {}", footerLength, DISCORD_EMBED_MAX_FOOTER_LENGTH);
+
+    if (authorLength > DISCORD_EMBED_MAX_AUTHOR_LENGTH)
+        return Warhead::StringFormat("author name length {} > {}", authorLength, DISCORD_EMBED_MAX_AUTHOR_LENGTH);
+
+    if (_fields.size() > DISCORD_EMBED_MAX_FIELDS_COUNT)
+        return Warhead::StringFormat("fields count {} > {}", _fields.size(), DISCORD_EMBED_MAX_FIELDS_COUNT);
+
+    std::size_t totalLength = titleLength + descriptionLength + footerLength + authorLength;
+
+    for (auto const& field : _fields)
+    {
+        if (field.Name.empty() || field.Value.empty())
+            return "field name and value can't be empty";
+
+        if (!utf8::is_valid(field.Name.begin(), field.Name.end()) || !utf8::is_valid(field.Value.begin(), field.Value.end()))
+            return "field is not valid utf8";
+
+        std::size_t const nameLength = GetLength(field.Name);
+        std::size_t const valueLength = GetLength(field.Value);
+
+        if (nameLength > DISCORD_EMBED_MAX_FIELD_NAME_LENGTH)
+            return Warhead::StringFormat("field name length {} > {}", nameLength, DISCORD_EMBED_MAX_FIELD_NAME_LENGTH);
+
+        if (valueLength > DISCORD_EMBED_MAX_FIELD_VALUE_LENGTH)
+            return Warhead::StringFormat("field value length {} > {}", valueLength, DISCORD_EMBED_MAX_FIELD_VALUE_LENGTH);
+
+        totalLength += nameLength + valueLength;
+    }
+
+    if (totalLength > DISCORD_EMBED_MAX_TOTAL_LENGTH)
+        return Warhead::StringFormat("total length {} > {}", totalLength, DISCORD_EMBED_MAX_TOTAL_LENGTH);
+
+    if (!totalLength && _image.empty() && _thumbnail.empty())
+        return "embed is empty";
+
+    return {};
+}
+
+std::size_t DiscordEmbed::GetSerializedSize() const
+{
+    std::size_t size = GetStringSize(_title) + GetStringSize(_description) + GetStringSize(_url) +
+        GetStringSize(_footerText) + GetStringSize(_footerIcon) + GetStringSize(_authorName) + GetStringSize(_authorUrl) +
+        GetStringSize(_authorIcon) + GetStringSize(_thumbnail) + GetStringSize(_image);
+
+    if (_color)
+        size += sizeof(DiscordEmbedTag) + sizeof(uint32);
+
+    if (_timestamp)
+        size += sizeof(DiscordEmbedTag) + sizeof(int64);
+
+    // tag + inline + name + value
+    for (auto const& field : _fields)
+        size += sizeof(DiscordEmbedTag) + sizeof(uint8) + field.Name.size() + 1 + field.Value.size() + 1;
+
+    // End tag
+    return size + sizeof(DiscordEmbedTag);
+}
+
+std::size_t DiscordEmbed::GetTextLength() const
+{
+    std::size_t length = GetLength(_title) + GetLength(_description) + GetLength(_footerText) + GetLength(_authorName);
+
+    for (auto const& field : _fields)
+        length += GetLength(field.Name) + GetLength(field.Value);
+
+    return length;
+}
+
+/*static*/ Optional<std::size_t> DiscordEmbed::GetTextLength(ByteBuffer const& buffer, std::size_t pos, std::size_t count)
+{
+    std::size_t const size = buffer.size();
+    if (!count)
+        return 0;
+
+    if (pos >= size)
+        return {};
+
+    char const* data = reinterpret_cast<char const*>(buffer.contents());
+    std::size_t length{ 0 };
+
+    // Null terminated string at pos, pos is moved after it
+    auto readString = [data, size, &pos](std::string_view& value)
+    {
+        void const* end = pos < size ? std::memchr(data + pos, 0, size - pos) : nullptr;
+        if (!end)
+            return false;
+
+        value = std::string_view(data + pos, static_cast<char const*>(end) - (data + pos));
+        pos += value.size() + 1;
+        return true;
+    };
+
+    std::string_view value;
+
+    while (count)
+    {
+        if (pos >= size)
+            return {};
+
+        switch (static_cast<DiscordEmbedTag>(data[pos++]))
+        {
+            case DiscordEmbedTag::End:
+                --count;
+                break;
+            case DiscordEmbedTag::Title:
+            case DiscordEmbedTag::Description:
+            case DiscordEmbedTag::FooterText:
+            case DiscordEmbedTag::AuthorName:
+                if (!readString(value))
+                    return {};
+
+                length += GetLength(value);
+                break;
+            case DiscordEmbedTag::Url:
+            case DiscordEmbedTag::FooterIcon:
+            case DiscordEmbedTag::AuthorUrl:
+            case DiscordEmbedTag::AuthorIcon:
+            case DiscordEmbedTag::Thumbnail:
+            case DiscordEmbedTag::Image:
+                if (!readString(value))
+                    return {};
+                break;
+            case DiscordEmbedTag::Color:
+                pos += sizeof(uint32);
+                break;
+            case DiscordEmbedTag::Timestamp:
+                pos += sizeof(int64);
+                break;
+            case DiscordEmbedTag::Field:
+                pos += sizeof(uint8);
+
+                for (uint8 i = 0; i < 2; ++i)
+                {
+                    if (!readString(value))
+                        return {};
+
+                    length += GetLength(value);
+                }
+                break;
+            default:
+                return {};
+        }
+    }
+
+    return length;
+}
+
+void DiscordEmbed::WriteTo(ByteBuffer& buffer) const
+{
+    std::string error = Validate();
+    if (!error.empty())
+        throw DiscordEmbedException(error);
+
+    buffer.reserve(buffer.wpos() + GetSerializedSize());
+
+    WriteString(buffer, DiscordEmbedTag::Title, _title);
+    WriteString(buffer, DiscordEmbedTag::Description, _description);
+    WriteString(buffer, DiscordEmbedTag::Url, _url);
+
+    if (_color)
+    {
+        buffer << uint8(DiscordEmbedTag::Color);
+        buffer << uint32(*_color);
+    }
+
+    if (_timestamp)
+    {
+        buffer << uint8(DiscordEmbedTag::Timestamp);
+        buffer << int64(*_timestamp);
+    }
+
+    WriteString(buffer, DiscordEmbedTag::FooterText, _footerText);
+    WriteString(buffer, DiscordEmbedTag::FooterIcon, _footerIcon);
+    WriteString(buffer, DiscordEmbedTag::AuthorName, _authorName);
+    WriteString(buffer, DiscordEmbedTag::AuthorUrl, _authorUrl);
+    WriteString(buffer, DiscordEmbedTag::AuthorIcon, _authorIcon);
+    WriteString(buffer, DiscordEmbedTag::Thumbnail, _thumbnail);
+    WriteString(buffer, DiscordEmbedTag::Image, _image);
+
+    for (auto const& field : _fields)
+    {
+        buffer << uint8(DiscordEmbedTag::Field);
+        buffer << uint8(field.Inline ? 1 : 0);
+        buffer << field.Name;
+        buffer << field.Value;
+    }
+
+    buffer << uint8(DiscordEmbedTag::End);
+}
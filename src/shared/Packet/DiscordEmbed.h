@@ -0,0 +1,93 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DISCORD_EMBED_H_
+#define _DISCORD_EMBED_H_
+
+#include "ByteBuffer.h"
+#include "DiscordSharedDefines.h"
+#include "Duration.h"
+#include "Optional.h"
+#include <string_view>
+
+class WH_SHARED_API DiscordEmbedException : public ByteBufferException
+{
+public:
+    explicit DiscordEmbedException(std::string_view error);
+
+    ~DiscordEmbedException() noexcept override = default;
+};
+
+/// Builder for CLIENT_SEND_MESSAGE_EMBED embed data.
+/// Discord limits are checked at build, so bad embeds never leave the client.
+class WH_SHARED_API DiscordEmbed
+{
+    struct Field
+    {
+        std::string Name;
+        std::string Value;
+        bool Inline{ false };
+    };
+
+public:
+    DiscordEmbed() = default;
+
+    DiscordEmbed& SetTitle(std::string_view title);
+    DiscordEmbed& SetDescription(std::string_view description);
+    DiscordEmbed& SetUrl(std::string_view url);
+    DiscordEmbed& SetColor(uint32 color);
+    DiscordEmbed& SetTimestamp(SystemTimePoint time);
+    DiscordEmbed& SetTimestamp(Seconds unixTime);
+    DiscordEmbed& SetFooter(std::string_view text, std::string_view iconUrl = {});
+    DiscordEmbed& SetAuthor(std::string_view name, std::string_view url = {}, std::string_view iconUrl = {});
+    DiscordEmbed& SetThumbnail(std::string_view url);
+    DiscordEmbed& SetImage(std::string_view url);
+    DiscordEmbed& AddField(std::string_view name, std::string_view value, bool isInline = false);
+
+    /// Returns the first broken discord limit, empty if embed is valid
+    std::string Validate() const;
+
+    /// Exact count of bytes written by WriteTo
+    std::size_t GetSerializedSize() const;
+
+    /// Characters counted by DISCORD_EMBED_MAX_TOTAL_LENGTH, the limit is for all embeds of one message
+    std::size_t GetTextLength() const;
+
+    /// Same for count embeds serialized by WriteTo from pos, empty if the data is broken
+    static Optional<std::size_t> GetTextLength(ByteBuffer const& buffer, std::size_t pos, std::size_t count);
+
+    /// Writes embed data with a single allocation of buffer.
+    /// Throws DiscordEmbedException if embed breaks discord limits.
+    void WriteTo(ByteBuffer& buffer) const;
+
+private:
+    std::string _title;
+    std::string _description;
+    std::string _url;
+    Optional<uint32> _color;
+    Optional<int64> _timestamp;
+    std::string _footerText;
+    std::string _footerIcon;
+    std::string _authorName;
+    std::string _authorUrl;
+    std::string _authorIcon;
+    std::string _thumbnail;
+    std::string _image;
+    std::vector<Field> _fields;
+};
+
+#endif
@@ -38,13 +38,15 @@ WH_API_EXPORT EnumText EnumUtils<DiscordCode>::ToString(DiscordCode value)
         case DiscordCode::CLIENT_SEND_PING: return { "CLIENT_SEND_PING", "CLIENT_SEND_PING", "" };
         case DiscordCode::SERVER_SEND_AUTH_RESPONSE: return { "SERVER_SEND_AUTH_RESPONSE", "SERVER_SEND_AUTH_RESPONSE", "" };
         case DiscordCode::SERVER_SEND_PONG: return { "SERVER_SEND_PONG", "SERVER_SEND_PONG", "" };
+        case DiscordCode::CLIENT_RESUME_SESSION: return { "CLIENT_RESUME_SESSION", "CLIENT_RESUME_SESSION", "" };
+        case DiscordCode::SERVER_SEND_RESUME_RESPONSE: return { "SERVER_SEND_RESUME_RESPONSE", "SERVER_SEND_RESUME_RESPONSE", "" };
         case DiscordCode::NUM_MSG_TYPES: return { "NUM_MSG_TYPES", "NUM_MSG_TYPES", "" };
         default: throw std::out_of_range("value");
     }
 }
 
 template<>
-WH_API_EXPORT size_t EnumUtils<DiscordCode>::Count() { return 8; }
+WH_API_EXPORT size_t EnumUtils<DiscordCode>::Count() { return 10; }
 
 template<>
 WH_API_EXPORT DiscordCode EnumUtils<DiscordCode>::FromIndex(size_t index)
@@ -58,7 +60,9 @@ WH_API_EXPORT DiscordCode EnumUtils<DiscordCode>::FromIndex(size_t index)
         case 4: return DiscordCode::CLIENT_SEND_PING;
         case 5: return DiscordCode::SERVER_SEND_AUTH_RESPONSE;
         case 6: return DiscordCode::SERVER_SEND_PONG;
-        case 7: return DiscordCode::NUM_MSG_TYPES;
+        case 7: return DiscordCode::CLIENT_RESUME_SESSION;
+        case 8: return DiscordCode::SERVER_SEND_RESUME_RESPONSE;
+        case 9: return DiscordCode::NUM_MSG_TYPES;
         default: throw std::out_of_range("index");
     }
 }
@@ -75,7 +79,9 @@ WH_API_EXPORT size_t EnumUtils<DiscordCode>::ToIndex(DiscordCode value)
         case DiscordCode::CLIENT_SEND_PING: return 4;
         case DiscordCode::SERVER_SEND_AUTH_RESPONSE: return 5;
         case DiscordCode::SERVER_SEND_PONG: return 6;
-        case DiscordCode::NUM_MSG_TYPES: return 7;
+        case DiscordCode::CLIENT_RESUME_SESSION: return 7;
+        case DiscordCode::SERVER_SEND_RESUME_RESPONSE: return 8;
+        case DiscordCode::NUM_MSG_TYPES: return 9;
         default: throw std::out_of_range("value");
     }
 }
@@ -97,12 +103,13 @@ WH_API_EXPORT EnumText EnumUtils<DiscordAuthResponseCodes>::ToString(DiscordAuth
         case DiscordAuthResponseCodes::BannedPermanentlyAccount: return { "BannedPermanentlyAccount", "BannedPermanentlyAccount", "" };
         case DiscordAuthResponseCodes::BannedPermanentlyIP: return { "BannedPermanentlyIP", "BannedPermanentlyIP", "" };
         case DiscordAuthResponseCodes::ServerOffline: return { "ServerOffline", "ServerOffline", "" };
+        case DiscordAuthResponseCodes::SessionExpired: return { "SessionExpired", "SessionExpired", "" };
         default: throw std::out_of_range("value");
     }
 }
 
 template<>
-WH_API_EXPORT size_t EnumUtils<DiscordAuthResponseCodes>::Count() { return 9; }
+WH_API_EXPORT size_t EnumUtils<DiscordAuthResponseCodes>::Count() { return 10; }
 
 template<>
 WH_API_EXPORT DiscordAuthResponseCodes EnumUtils<DiscordAuthResponseCodes>::FromIndex(size_t index)
@@ -118,6 +125,7 @@ WH_API_EXPORT DiscordAuthResponseCodes EnumUtils<DiscordAuthResponseCodes>::From
         case 6: return DiscordAuthResponseCodes::BannedPermanentlyAccount;
         case 7: return DiscordAuthResponseCodes::BannedPermanentlyIP;
         case 8: return DiscordAuthResponseCodes::ServerOffline;
+        case 9: return DiscordAuthResponseCodes::SessionExpired;
         default: throw std::out_of_range("index");
     }
 }
@@ -136,6 +144,7 @@ WH_API_EXPORT size_t EnumUtils<DiscordAuthResponseCodes>::ToIndex(DiscordAuthRes
         case DiscordAuthResponseCodes::BannedPermanentlyAccount: return 6;
         case DiscordAuthResponseCodes::BannedPermanentlyIP: return 7;
         case DiscordAuthResponseCodes::ServerOffline: return 8;
+        case DiscordAuthResponseCodes::SessionExpired: return 9;
         default: throw std::out_of_range("value");
     }
 }
@@ -0,0 +1,277 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Prints the text of a binary log file written by a LogChannel of type 3.
+// Usage: LogDecoder <file> [filter]
+
+#include "LogBinaryFormat.h"
+#include "Timer.h"
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <fmt/args.h>
+#include <fmt/format.h>
+
+namespace
+{
+    struct SiteInfo
+    {
+        uint8 Level;
+        uint32 Line;
+        std::string_view File;
+        std::string_view Filter;
+        std::string_view Format;
+    };
+
+    constexpr std::string_view LevelNames[] = { "DISABLED", "FATAL", "CRITICAL", "ERROR", "WARNING", "NOTICE", "INFO", "DEBUG", "TRACE" };
+
+    std::string_view GetLevelName(uint8 level)
+    {
+        return level < std::size(LevelNames) ? LevelNames[level] : "UNKNOWN";
+    }
+
+    template<typename T>
+    bool ReadValue(char const*& data, char const* end, T& value)
+    {
+        if (std::size_t(end - data) < sizeof(T))
+            return false;
+
+        std::memcpy(&value, data, sizeof(T));
+        data += sizeof(T);
+        return true;
+    }
+
+    // Rebuilds the arguments of one record, false if the record is cut or has an unknown tag
+    bool ReadArguments(char const* data, char const* end, fmt::dynamic_format_arg_store<fmt::format_context>& store)
+    {
+        while (data < end)
+        {
+            uint8 type;
+            if (!ReadValue(data, end, type))
+                return false;
+
+            // Zero bytes align the record
+            if (!type)
+                return true;
+
+            switch (LogBinaryArgType(type))
+            {
+                case LogBinaryArgType::LOG_BINARY_ARG_INT:
+                {
+                    int64 value;
+                    if (!ReadValue(data, end, value))
+                        return false;
+
+                    store.push_back(value);
+                    break;
+                }
+                case LogBinaryArgType::LOG_BINARY_ARG_UINT:
+                {
+                    uint64 value;
+                    if (!ReadValue(data, end, value))
+                        return false;
+
+                    store.push_back(value);
+                    break;
+                }
+                case LogBinaryArgType::LOG_BINARY_ARG_DOUBLE:
+                {
+                    double value;
+                    if (!ReadValue(data, end, value))
+                        return false;
+
+                    store.push_back(value);
+                    break;
+                }
+                case LogBinaryArgType::LOG_BINARY_ARG_BOOL:
+                {
+                    uint8 value;
+                    if (!ReadValue(data, end, value))
+                        return false;
+
+                    store.push_back(value != 0);
+                    break;
+                }
+                case LogBinaryArgType::LOG_BINARY_ARG_CHAR:
+                {
+                    char value;
+                    if (!ReadValue(data, end, value))
+                        return false;
+
+                    store.push_back(value);
+                    break;
+                }
+                case LogBinaryArgType::LOG_BINARY_ARG_STRING:
+                {
+                    uint32 length;
+                    if (!ReadValue(data, end, length) || std::size_t(end - data) < length)
+                        return false;
+
+                    store.push_back(std::string(data, length));
+                    data += length;
+                    break;
+                }
+                case LogBinaryArgType::LOG_BINARY_ARG_POINTER:
+                {
+                    uint64 value;
+                    if (!ReadValue(data, end, value))
+                        return false;
+
+                    store.push_back(reinterpret_cast<void const*>(static_cast<uintptr_t>(value)));
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+
+        return true;
+    }
+
+    std::string FormatTime(int64 time)
+    {
+        int64 seconds = time / 1000000000;
+        return fmt::format("{}.{:09}", Warhead::Time::TimeToTimestampStr(Seconds(seconds)), time % 1000000000);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        fmt::print(stderr, "Usage: {} <file> [filter]\n", argv[0]);
+        return 1;
+    }
+
+    std::string_view filterName = argc > 2 ? argv[2] : "";
+
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in)
+    {
+        fmt::print(stderr, "Can't open file '{}'\n", argv[1]);
+        return 1;
+    }
+
+    std::vector<char> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    LogBinaryFileHeader header;
+    if (file.size() < sizeof(header))
+    {
+        fmt::print(stderr, "File '{}' is too small\n", argv[1]);
+        return 1;
+    }
+
+    std::memcpy(&header, file.data(), sizeof(header));
+
+    if (std::memcmp(header.Magic, LOG_BINARY_MAGIC, sizeof(header.Magic)) || header.Version != LOG_BINARY_VERSION)
+    {
+        fmt::print(stderr, "File '{}' is not a binary log of version {}\n", argv[1], LOG_BINARY_VERSION);
+        return 1;
+    }
+
+    if (header.SiteTableOffset + header.SiteTableUsed > file.size() || header.RingOffset + header.RingSize > file.size() ||
+        header.Head >= header.RingSize || header.Tail >= header.RingSize || header.Used > header.RingSize)
+    {
+        fmt::print(stderr, "File '{}' is damaged\n", argv[1]);
+        return 1;
+    }
+
+    // Call sites
+    std::unordered_map<uint32, SiteInfo> sites;
+    char const* siteData = file.data() + header.SiteTableOffset;
+    char const* siteEnd = siteData + header.SiteTableUsed;
+
+    while (std::size_t(siteEnd - siteData) >= sizeof(LogBinarySiteHeader))
+    {
+        LogBinarySiteHeader site;
+        std::memcpy(&site, siteData, sizeof(site));
+
+        if (site.Size < sizeof(site) || site.Size > std::size_t(siteEnd - siteData) ||
+            sizeof(site) + site.FileLength + site.FilterLength + site.FormatLength > site.Size)
+            break;
+
+        char const* text = siteData + sizeof(site);
+        SiteInfo& info = sites[site.SiteID];
+        info.Level = site.Level;
+        info.Line = site.Line;
+        info.File = { text, site.FileLength };
+        info.Filter = { text + site.FileLength, site.FilterLength };
+        info.Format = { text + site.FileLength + site.FilterLength, site.FormatLength };
+
+        siteData += site.Size;
+    }
+
+    // Records, oldest first
+    char const* ring = file.data() + header.RingOffset;
+    uint64 offset = header.Tail;
+    uint64 left = header.Used;
+
+    while (left)
+    {
+        uint32 size;
+        std::memcpy(&size, ring + offset, sizeof(size));
+
+        if (size < sizeof(size) * 2 || size > left || offset + size > header.RingSize)
+        {
+            fmt::print(stderr, "Damaged record at {}, stop\n", offset);
+            break;
+        }
+
+        LogBinaryRecordHeader record{};
+        std::memcpy(&record, ring + offset, std::min<std::size_t>(size, sizeof(record)));
+
+        if (record.SiteID != LOG_BINARY_PAD_SITE)
+        {
+            auto const& itr = sites.find(record.SiteID);
+            if (itr == sites.end())
+                fmt::print("{} UNKNOWN site {}\n", FormatTime(record.Time), record.SiteID);
+            else if (filterName.empty() || itr->second.Filter == filterName)
+            {
+                SiteInfo const& site = itr->second;
+                fmt::dynamic_format_arg_store<fmt::format_context> store;
+                std::string message;
+
+                if (size < sizeof(record) || !ReadArguments(ring + offset + sizeof(record), ring + offset + size, store))
+                    message = fmt::format("<damaged arguments> {}", site.Format);
+                else
+                {
+                    try
+                    {
+                        message = fmt::vformat(site.Format, store);
+                    }
+                    catch (fmt::format_error const& e)
+                    {
+                        message = fmt::format("<{}> {}", e.what(), site.Format);
+                    }
+                }
+
+                fmt::print("{} {} [{}] {}\n", FormatTime(record.Time), GetLevelName(site.Level), site.Filter, message);
+            }
+        }
+
+        left -= size;
+        offset += size;
+        if (offset == header.RingSize)
+            offset = 0;
+    }
+
+    fmt::print(stderr, "{} records written, {} dropped, {} bytes in the ring\n", header.Records, header.Dropped, header.Used);
+    return 0;
+}
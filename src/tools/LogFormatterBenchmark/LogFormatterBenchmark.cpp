@@ -0,0 +1,133 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Benchmark of the log line formatters: Poco::PatternFormatter against LogPatternFormatter,
+// with the line timestamps advancing like a server logging at a steady rate.
+// Usage: LogFormatterBenchmark [lines = 1000000] [lines per second = 10000] [runs = 5]
+
+#include "Define.h"
+#include "LogPatternFormatter.h"
+#include <Poco/AutoPtr.h>
+#include <Poco/Message.h>
+#include <Poco/PatternFormatter.h>
+#include <Poco/Timestamp.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fmt/format.h>
+
+namespace
+{
+    struct BenchmarkConfig
+    {
+        uint32 Lines{ 1000000 };
+        uint32 LinesPerSecond{ 10000 };
+        uint32 Runs{ 5 };
+    };
+
+    constexpr std::string_view Patterns[] =
+    {
+        "%Y-%m-%d %H:%M:%S %t",
+        "[%H:%M:%S] %t",
+        "%Y-%m-%d %H:%M:%S.%i %s [%p]: %t"
+    };
+
+    constexpr std::string_view Times[] = { "UTC", "local" };
+
+    constexpr Poco::Timestamp::TimeVal FirstLineTime = 1700000000000000; // microseconds
+
+    // Returns nanoseconds per line, text is the output of the last line
+    double RunOnce(BenchmarkConfig const& config, Poco::Formatter& formatter, std::string& text)
+    {
+        Poco::Message msg("server.world", "Player Name (guid 12345) logged in from 127.0.0.1, 42 characters", Poco::Message::PRIO_INFORMATION);
+        Poco::Timestamp::TimeVal const step = Poco::Timestamp::resolution() / config.LinesPerSecond;
+
+        auto begin = std::chrono::steady_clock::now();
+
+        for (uint32 i = 0; i < config.Lines; ++i)
+        {
+            msg.setTime(Poco::Timestamp(FirstLineTime + Poco::Timestamp::TimeVal(i) * step));
+
+            // New string for each line, like Poco::FormattingChannel
+            std::string line;
+            formatter.format(msg, line);
+            text.swap(line);
+        }
+
+        auto end = std::chrono::steady_clock::now();
+        return double(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count()) / config.Lines;
+    }
+
+    double Run(BenchmarkConfig const& config, Poco::Formatter& formatter, std::string& text)
+    {
+        std::vector<double> results;
+
+        for (uint32 run = 0; run < config.Runs; ++run)
+            results.emplace_back(RunOnce(config, formatter, text));
+
+        std::sort(results.begin(), results.end());
+        return results[results.size() / 2];
+    }
+
+    uint32 GetArgument(int argc, char** argv, int index, uint32 def)
+    {
+        if (argc <= index)
+            return def;
+
+        return std::max<uint32>(1, uint32(std::stoul(argv[index])));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    BenchmarkConfig config;
+    config.Lines = GetArgument(argc, argv, 1, config.Lines);
+    config.LinesPerSecond = std::min<uint32>(GetArgument(argc, argv, 2, config.LinesPerSecond), Poco::Timestamp::resolution());
+    config.Runs = GetArgument(argc, argv, 3, config.Runs);
+
+    fmt::print("{} lines at {} lines per second, median of {} runs\n\n", config.Lines, config.LinesPerSecond, config.Runs);
+    fmt::print("{:<36} {:<6} {:>12} {:>12}\n", "pattern", "times", "Poco", "native");
+
+    for (std::string_view pattern : Patterns)
+    {
+        for (std::string_view times : Times)
+        {
+            Poco::AutoPtr<Poco::PatternFormatter> poco(new Poco::PatternFormatter());
+            Poco::AutoPtr<LogPatternFormatter> native(new LogPatternFormatter());
+
+            for (Poco::Formatter* formatter : { static_cast<Poco::Formatter*>(poco.get()), static_cast<Poco::Formatter*>(native.get()) })
+            {
+                formatter->setProperty("pattern", std::string(pattern));
+                formatter->setProperty("times", std::string(times));
+            }
+
+            std::string pocoText;
+            std::string nativeText;
+            double const pocoTime = Run(config, *poco, pocoText);
+            double const nativeTime = Run(config, *native, nativeText);
+
+            fmt::print("{:<36} {:<6} {:>9.1f} ns {:>9.1f} ns\n", pattern, times, pocoTime, nativeTime);
+
+            if (pocoText != nativeText)
+                fmt::print("  ! output differs:\n    Poco:   {}\n    native: {}\n", pocoText, nativeText);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,302 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Contention benchmark of the packet queues: producers push pointers as fast as they can,
+// one consumer drains them, like the io thread drains game threads.
+// Usage: QueueBenchmark [producers = 8] [items per producer = 1000000] [runs = 5]
+
+#include "Define.h"
+#include "MPSCQueue.h"
+#include "PacketQueue.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <fmt/format.h>
+
+namespace
+{
+    struct BenchmarkPacket
+    {
+        uint32 Producer{ 0 };
+        uint32 Index{ 0 };
+        std::atomic<BenchmarkPacket*> QueueLink{ nullptr };
+    };
+
+    struct BenchmarkConfig
+    {
+        uint32 Producers{ 8 };
+        uint32 Items{ 1000000 };
+        uint32 Runs{ 5 };
+    };
+
+    // Producers start together, the consumer runs on the calling thread.
+    // Returns nanoseconds per item from the start to the last dequeued item
+    template<typename Push, typename Drain>
+    double RunOnce(BenchmarkConfig const& config, std::vector<BenchmarkPacket>& packets, Push push, Drain drain)
+    {
+        std::atomic<bool> start{ false };
+        std::vector<std::thread> producers;
+        std::size_t const total = std::size_t(config.Producers) * config.Items;
+
+        for (uint32 producer = 0; producer < config.Producers; ++producer)
+        {
+            producers.emplace_back([&, producer]()
+            {
+                while (!start.load(std::memory_order_acquire))
+                    std::this_thread::yield();
+
+                BenchmarkPacket* packet = &packets[std::size_t(producer) * config.Items];
+
+                for (uint32 i = 0; i < config.Items; ++i)
+                    push(packet + i);
+            });
+        }
+
+        auto begin = std::chrono::steady_clock::now();
+        start.store(true, std::memory_order_release);
+
+        // Per producer order must hold
+        std::vector<uint32> nextIndex(config.Producers, 0);
+        std::size_t received{ 0 };
+        bool ordered{ true };
+
+        while (received < total)
+        {
+            std::size_t count = drain([&](BenchmarkPacket* packet)
+            {
+                ordered &= packet->Index == nextIndex[packet->Producer]++;
+            });
+
+            if (!count)
+                std::this_thread::yield();
+
+            received += count;
+        }
+
+        auto end = std::chrono::steady_clock::now();
+
+        for (auto& thread : producers)
+            thread.join();
+
+        if (!ordered)
+            fmt::print("  ! per producer order is broken\n");
+
+        return double(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count()) / total;
+    }
+
+    template<typename Queue, typename Push, typename Drain>
+    void Run(std::string_view name, BenchmarkConfig const& config, std::vector<BenchmarkPacket>& packets, std::function<Queue*()> const& create, Push push, Drain drain)
+    {
+        std::vector<double> results;
+
+        for (uint32 run = 0; run < config.Runs; ++run)
+        {
+            std::unique_ptr<Queue> queue(create());
+            results.emplace_back(RunOnce(config, packets,
+                [&](BenchmarkPacket* packet) { push(*queue, packet); },
+                [&](auto const& callback) { return drain(*queue, callback); }));
+        }
+
+        std::sort(results.begin(), results.end());
+        double const median = results[results.size() / 2];
+
+        fmt::print("{:<36} {:>8.1f} ns/item {:>8.2f} Mitems/s  (min {:.1f}, max {:.1f})\n",
+            name, median, 1000.0 / median, results.front(), results.back());
+    }
+
+    constexpr std::size_t DrainBatchSize = 64;
+    constexpr std::size_t RingCapacity = 65536;
+
+    void RunPacketQueues(BenchmarkConfig const& config, std::vector<BenchmarkPacket>& packets)
+    {
+        using MutexQueue = PacketQueue<BenchmarkPacket>;
+        using RingQueue = RingPacketQueue<BenchmarkPacket>;
+
+        Run<MutexQueue>("PacketQueue (mutex + deque)", config, packets,
+            []() { return new MutexQueue(); },
+            [](MutexQueue& queue, BenchmarkPacket* packet) { queue.AddPacket(packet); },
+            [](MutexQueue& queue, auto const& callback)
+            {
+                std::size_t count{ 0 };
+                BenchmarkPacket* packet{ nullptr };
+
+                while (count < DrainBatchSize && queue.GetNextPacket(packet))
+                {
+                    callback(packet);
+                    ++count;
+                }
+
+                return count;
+            });
+
+        // Full ring makes the producer retry, like a caller that can't drop
+        auto ringPush = [](RingQueue& queue, BenchmarkPacket* packet)
+        {
+            while (!queue.AddPacket(packet))
+                std::this_thread::yield();
+        };
+
+        Run<RingQueue>("RingPacketQueue (single dequeue)", config, packets,
+            []() { return new RingQueue(RingCapacity); }, ringPush,
+            [](RingQueue& queue, auto const& callback)
+            {
+                std::size_t count{ 0 };
+                BenchmarkPacket* packet{ nullptr };
+
+                while (count < DrainBatchSize && queue.GetNextPacket(packet))
+                {
+                    callback(packet);
+                    ++count;
+                }
+
+                return count;
+            });
+
+        Run<RingQueue>("RingPacketQueue (bulk dequeue 64)", config, packets,
+            []() { return new RingQueue(RingCapacity); }, ringPush,
+            [](RingQueue& queue, auto const& callback)
+            {
+                std::array<BenchmarkPacket*, DrainBatchSize> batch;
+                std::size_t count = queue.GetNextPackets(batch.data(), batch.size());
+
+                for (std::size_t i = 0; i < count; ++i)
+                    callback(batch[i]);
+
+                return count;
+            });
+    }
+
+    // MPSCQueueNonIntrusive before node pooling, a heap node for each element
+    template<typename T>
+    class HeapNodeMPSCQueue
+    {
+    public:
+        HeapNodeMPSCQueue() : _head(new Node()), _tail(_head.load(std::memory_order_relaxed)) { }
+
+        ~HeapNodeMPSCQueue()
+        {
+            T* output;
+            while (Dequeue(output)) { }
+
+            delete _head.load(std::memory_order_relaxed);
+        }
+
+        void Enqueue(T* input)
+        {
+            Node* node = new Node(input);
+            Node* prevHead = _head.exchange(node, std::memory_order_acq_rel);
+            prevHead->Next.store(node, std::memory_order_release);
+        }
+
+        bool Dequeue(T*& result)
+        {
+            Node* tail = _tail.load(std::memory_order_relaxed);
+            Node* next = tail->Next.load(std::memory_order_acquire);
+            if (!next)
+                return false;
+
+            result = next->Data;
+            _tail.store(next, std::memory_order_release);
+            delete tail;
+            return true;
+        }
+
+    private:
+        struct Node
+        {
+            Node() = default;
+            explicit Node(T* data) : Data(data) { }
+
+            T* Data{ nullptr };
+            std::atomic<Node*> Next{ nullptr };
+        };
+
+        std::atomic<Node*> _head;
+        std::atomic<Node*> _tail;
+    };
+
+    template<typename Queue>
+    void RunMPSCQueue(std::string_view name, BenchmarkConfig const& config, std::vector<BenchmarkPacket>& packets)
+    {
+        Run<Queue>(name, config, packets,
+            []() { return new Queue(); },
+            [](Queue& queue, BenchmarkPacket* packet) { queue.Enqueue(packet); },
+            [](Queue& queue, auto const& callback)
+            {
+                std::size_t count{ 0 };
+                BenchmarkPacket* packet{ nullptr };
+
+                while (count < DrainBatchSize && queue.Dequeue(packet))
+                {
+                    callback(packet);
+                    ++count;
+                }
+
+                return count;
+            });
+    }
+
+    // Queues only hold pointers to the preallocated packets, the queue destructors don't delete anything
+    void RunMPSCQueues(BenchmarkConfig const& config, std::vector<BenchmarkPacket>& packets)
+    {
+        RunMPSCQueue<HeapNodeMPSCQueue<BenchmarkPacket>>("MPSCQueue (heap node per item)", config, packets);
+        RunMPSCQueue<MPSCQueue<BenchmarkPacket>>("MPSCQueue (pooled nodes)", config, packets);
+        RunMPSCQueue<MPSCQueue<BenchmarkPacket, &BenchmarkPacket::QueueLink>>("MPSCQueue (intrusive link)", config, packets);
+    }
+
+    uint32 GetArgument(int argc, char** argv, int index, uint32 def)
+    {
+        if (argc <= index)
+            return def;
+
+        return std::max<uint32>(1, uint32(std::stoul(argv[index])));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    BenchmarkConfig config;
+    config.Producers = GetArgument(argc, argv, 1, config.Producers);
+    config.Items = GetArgument(argc, argv, 2, config.Items);
+    config.Runs = GetArgument(argc, argv, 3, config.Runs);
+
+    fmt::print("{} producers x {} items, 1 consumer, median of {} runs, {} hardware threads\n\n",
+        config.Producers, config.Items, config.Runs, std::thread::hardware_concurrency());
+
+    std::vector<BenchmarkPacket> packets(std::size_t(config.Producers) * config.Items);
+
+    for (uint32 producer = 0; producer < config.Producers; ++producer)
+    {
+        for (uint32 i = 0; i < config.Items; ++i)
+        {
+            packets[std::size_t(producer) * config.Items + i].Producer = producer;
+            packets[std::size_t(producer) * config.Items + i].Index = i;
+        }
+    }
+
+    RunPacketQueues(config, packets);
+    fmt::print("\n");
+    RunMPSCQueues(config, packets);
+    return 0;
+}
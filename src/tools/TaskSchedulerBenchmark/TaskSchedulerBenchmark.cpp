@@ -0,0 +1,158 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Benchmark of the TaskScheduler with many pending timers: timers are scheduled with a random
+// delay of up to 10 minutes in groups, some groups are canceled and delayed, then the scheduler
+// is updated in 10ms steps until every timer expired.
+// Usage: TaskSchedulerBenchmark [timers = 100000] [groups = 1000] [runs = 5]
+
+#include "Define.h"
+#include "Duration.h"
+#include "TaskScheduler.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fmt/format.h>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    constexpr uint32 MaxDelayMs = 10 * 60 * 1000;
+    constexpr uint32 UpdateDiffMs = 10;
+    constexpr uint32 ModifiedGroups = 10;
+
+    struct BenchmarkConfig
+    {
+        uint32 Timers{ 100000 };
+        uint32 Groups{ 1000 };
+        uint32 Runs{ 5 };
+    };
+
+    struct RunResult
+    {
+        double Schedule{ 0 };
+        double Cancel{ 0 };
+        double Delay{ 0 };
+        double Update{ 0 };
+        uint32 Fired{ 0 };
+    };
+
+    double GetMilliseconds(Clock::time_point begin)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+    }
+
+    // Same seed for every run, so all runs see the same delays
+    RunResult RunOnce(BenchmarkConfig const& config)
+    {
+        RunResult result;
+        TaskScheduler scheduler;
+        std::mt19937 random(1);
+
+        auto begin = Clock::now();
+
+        for (uint32 i = 0; i < config.Timers; ++i)
+        {
+            scheduler.Schedule(Milliseconds(1 + random() % MaxDelayMs), i % config.Groups, [&result](TaskContext)
+            {
+                ++result.Fired;
+            });
+        }
+
+        result.Schedule = GetMilliseconds(begin);
+
+        begin = Clock::now();
+
+        for (uint32 group = 0; group < ModifiedGroups; ++group)
+            scheduler.CancelGroup(group);
+
+        result.Cancel = GetMilliseconds(begin);
+
+        begin = Clock::now();
+
+        for (uint32 group = ModifiedGroups; group < ModifiedGroups * 2; ++group)
+            scheduler.DelayGroup(group, Seconds(5));
+
+        result.Delay = GetMilliseconds(begin);
+
+        // Delayed timers expire up to 5 seconds after the last one
+        uint32 const updates = (MaxDelayMs + 5000) / UpdateDiffMs + 1;
+
+        begin = Clock::now();
+
+        for (uint32 i = 0; i < updates; ++i)
+            scheduler.Update(Milliseconds(UpdateDiffMs));
+
+        result.Update = GetMilliseconds(begin);
+        return result;
+    }
+
+    void Print(std::string_view name, std::vector<RunResult> const& results, double RunResult::* field, uint32 count)
+    {
+        std::vector<double> values;
+
+        for (RunResult const& result : results)
+            values.emplace_back(result.*field);
+
+        std::sort(values.begin(), values.end());
+        double const median = values[values.size() / 2];
+
+        fmt::print("{:<36} {:>9.2f} ms {:>9.1f} ns/timer  (min {:.2f}, max {:.2f})\n",
+            name, median, median * 1000000.0 / std::max<uint32>(1, count), values.front(), values.back());
+    }
+
+    uint32 GetArgument(int argc, char** argv, int index, uint32 def)
+    {
+        if (argc <= index)
+            return def;
+
+        return std::max<uint32>(1, uint32(std::stoul(argv[index])));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    BenchmarkConfig config;
+    config.Timers = GetArgument(argc, argv, 1, config.Timers);
+    config.Groups = std::max(GetArgument(argc, argv, 2, config.Groups), ModifiedGroups * 2);
+    config.Runs = GetArgument(argc, argv, 3, config.Runs);
+
+    fmt::print("{} timers over {} minutes in {} groups, updates every {}ms, median of {} runs\n\n",
+        config.Timers, MaxDelayMs / 60000, config.Groups, UpdateDiffMs, config.Runs);
+
+    std::vector<RunResult> results;
+
+    for (uint32 run = 0; run < config.Runs; ++run)
+        results.emplace_back(RunOnce(config));
+
+    // Timers of a group, the group of a timer is its index modulo the groups
+    uint32 const groupTimers = config.Timers / config.Groups;
+
+    Print("schedule", results, &RunResult::Schedule, config.Timers);
+    Print(fmt::format("cancel {} groups", ModifiedGroups), results, &RunResult::Cancel, groupTimers * ModifiedGroups);
+    Print(fmt::format("delay {} groups", ModifiedGroups), results, &RunResult::Delay, groupTimers * ModifiedGroups);
+    Print("update until all expired", results, &RunResult::Update, results.front().Fired);
+
+    if (std::any_of(results.begin(), results.end(), [&](RunResult const& result) { return result.Fired != results.front().Fired; }))
+        fmt::print("  ! runs fired a different count of timers\n");
+
+    return 0;
+}